@@ -18,6 +18,9 @@
 #include "image.h"
 #include "gradient.h"
 #include "hint.h"
+#include "event.h"
+#include "timing.h"
+#include "settings.h"
 
 /** Enumeration of background types. */
 typedef unsigned char BackgroundType;
@@ -28,79 +31,120 @@ typedef unsigned char BackgroundType;
 #define BACKGROUND_TILE       4  /**< Tiled image. */
 #define BACKGROUND_SCALE      5  /**< Scaled image. */
 
+/** Delay before decoding the backgrounds of neighboring desktops. */
+#define PREFETCH_DELAY 500
+
 /** Structure to represent a background for one or more desktops. */
 typedef struct BackgroundNode {
    int desktop;                  /**< The desktop. */
    BackgroundType type;          /**< The type of background. */
    char *value;
    Pixmap pixmap;
+   char loaded;                  /**< Set once the pixmap is loaded. */
+   char shared;                  /**< Set if the pixmap is owned by another
+                                  *   background with the same value. */
    struct BackgroundNode *next;  /**< Next background in the list. */
 } BackgroundNode;
 
 /** Linked list of backgrounds. */
 static BackgroundNode *backgrounds;
 
-/** The default background. */
-static BackgroundNode *defaultBackground;
-
 /** The last background loaded. */
 static BackgroundNode *lastBackground;
 
+/** Backgrounds of neighboring desktops requested by SignalBackground. */
+static const BackgroundNode *prefetched[2];
+
+/** Set while SignalBackground is registered. */
+static char prefetchPending;
+
+/** Time of the last desktop switch. */
+static TimeType prefetchTime;
+
+static BackgroundNode *GetBackground(int desktop);
+static void ShowBackground(BackgroundNode *bp);
+static void PreloadBackground(const BackgroundNode *bp, char cancel);
+static void DropPrefetched(int desktop);
+static char IsSameBackground(const BackgroundNode *a,
+                             const BackgroundNode *b);
+static char IsPixmapLoaded(const BackgroundNode *bp);
+static void LoadBackgroundPixmap(BackgroundNode *bp);
 static void LoadGradientBackground(BackgroundNode *bp);
 static void LoadImageBackground(BackgroundNode *bp);
+static void SignalBackground(const TimeType *now, int x, int y, Window w,
+                             void *data);
 
 /** Initialize any data needed for background support. */
 void InitializeBackgrounds(void)
 {
    backgrounds = NULL;
-   defaultBackground = NULL;
    lastBackground = NULL;
+   prefetched[0] = NULL;
+   prefetched[1] = NULL;
+   prefetchPending = 0;
 }
 
-/** Startup background support. */
-void StartupBackgrounds(void)
+/** Request that background images be decoded ahead of time.
+ * Only the background for the initial desktop is decoded.
+ */
+void PreloadBackgrounds(void)
 {
+   const BackgroundNode *bp = GetBackground(GetInitialDesktop());
+   if(bp) {
+      PreloadBackground(bp, 0);
+   }
+}
 
-   BackgroundNode *bp;
-
-   for(bp = backgrounds; bp; bp = bp->next) {
-
-      /* Load background data. */
-      switch(bp->type) {
-      case BACKGROUND_SOLID:
-      case BACKGROUND_GRADIENT:
-         LoadGradientBackground(bp);
-         break;
-      case BACKGROUND_COMMAND:
-         /* Nothing to do. */
-         break;
-      case BACKGROUND_STRETCH:
-      case BACKGROUND_TILE:
-      case BACKGROUND_SCALE:
-         LoadImageBackground(bp);
-         break;
-      default:
-         Debug("invalid background type in LoadBackground: %d", bp->type);
-         break;
+/** Request (or cancel a request) that the image for a background be
+ * decoded ahead of time.
+ */
+void PreloadBackground(const BackgroundNode *bp, char cancel)
+{
+   switch(bp->type) {
+   case BACKGROUND_STRETCH:
+   case BACKGROUND_SCALE:
+      /* This must match the request made by LoadImageBackground. */
+      if(cancel) {
+         CancelPreloadedIcon(bp->value, rootWidth, rootHeight,
+                             bp->type == BACKGROUND_SCALE);
+      } else {
+         PreloadSizedIcon(bp->value, rootWidth, rootHeight,
+                          bp->type == BACKGROUND_SCALE);
       }
-
-      if(bp->desktop == -1) {
-         defaultBackground = bp;
+      break;
+   case BACKGROUND_TILE:
+      if(cancel) {
+         CancelPreloadedIcon(bp->value, 0, 0, 0);
+      } else {
+         PreloadSizedIcon(bp->value, 0, 0, 0);
       }
-
+      break;
+   default:
+      break;
    }
-
 }
 
 /** Shutdown background support. */
 void ShutdownBackgrounds(void)
 {
    BackgroundNode *bp;
+   if(prefetchPending) {
+      UnregisterCallback(SignalBackground, NULL);
+      prefetchPending = 0;
+   }
+
+   /* Drop any neighboring backgrounds that were decoded but not used. */
+   DiscardPreloadedImages();
+   prefetched[0] = NULL;
+   prefetched[1] = NULL;
+
    for(bp = backgrounds; bp; bp = bp->next) {
-      if(bp->pixmap != None) {
+      if(bp->pixmap != None && !bp->shared) {
          JXFreePixmap(display, bp->pixmap);
-         bp->pixmap = None;
       }
+      bp->pixmap = None;
+      bp->loaded = 0;
+      bp->shared = 0;
    }
 }
 
@@ -173,6 +217,12 @@ void SetBackground(int desktop, const char *type, const char *value)
    bp->type = bgType;
    bp->value = CopyString(value);
    bp->pixmap = None;
+   bp->loaded = 0;
+   bp->shared = 0;
+   if(bgType == BACKGROUND_STRETCH || bgType == BACKGROUND_TILE
+      || bgType == BACKGROUND_SCALE) {
+      ExpandPath(&bp->value);
+   }
 
    /* Insert the node into the list. */
    bp->next = backgrounds;
@@ -180,33 +230,59 @@ void SetBackground(int desktop, const char *type, const char *value)
 
 }
 
+/** Get the background for a desktop. */
+BackgroundNode *GetBackground(int desktop)
+{
+   BackgroundNode *defaultBackground = NULL;
+   BackgroundNode *bp;
+   for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->desktop == desktop) {
+         return bp;
+      } else if(bp->desktop == -1) {
+         defaultBackground = bp;
+      }
+   }
+   return defaultBackground;
+}
+
 /** Load the background for the specified desktop. */
 void LoadBackground(int desktop)
 {
 
-   XSetWindowAttributes attr;
-   unsigned long attrValues;
    BackgroundNode *bp;
 
    /* Determine the background to load. */
-   for(bp = backgrounds; bp; bp = bp->next) {
-      if(bp->desktop == desktop) {
-         break;
-      }
-   }
-   if(!bp) {
-      bp = defaultBackground;
-   }
+   bp = GetBackground(desktop);
 
    /* If there is no background specified for this desktop, just return. */
    if(!bp || !bp->value) {
       return;
    }
 
+   ShowBackground(bp);
+
+   /* Decode the neighboring backgrounds once things settle down.
+    * SignalBackground waits until PREFETCH_DELAY has passed. */
+   if(settings.desktopCount > 1) {
+      DropPrefetched(desktop);
+      GetCurrentTime(&prefetchTime);
+      if(!prefetchPending) {
+         prefetchPending = 1;
+         RegisterCallback(PREFETCH_DELAY, SignalBackground, NULL);
+      }
+   }
+
+}
+
+/** Set the root window background. */
+void ShowBackground(BackgroundNode *bp)
+{
+
+   XSetWindowAttributes attr;
+   unsigned long attrValues;
+
    /* If the background isn't changing, don't do anything. */
-   if(   lastBackground
-      && bp->type == lastBackground->type
-      && !strcmp(bp->value, lastBackground->value)) {
+   if(lastBackground && IsSameBackground(bp, lastBackground)) {
       return;
    }
    lastBackground = bp;
@@ -217,6 +293,7 @@ void LoadBackground(int desktop)
       return;
    }
 
+   LoadBackgroundPixmap(bp);
    attrValues = CWBackPixmap;
    attr.background_pixmap = bp->pixmap;
    JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
@@ -225,6 +302,116 @@ void LoadBackground(int desktop)
 
 }
 
+/** Load the pixmap for a background if it isn't already loaded.
+ * Backgrounds with the same type and value share a pixmap.
+ */
+void LoadBackgroundPixmap(BackgroundNode *bp)
+{
+   BackgroundNode *other;
+
+   if(bp->loaded) {
+      return;
+   }
+   bp->loaded = 1;
+
+   for(other = backgrounds; other; other = other->next) {
+      if(other->loaded && other != bp && IsSameBackground(other, bp)) {
+         bp->pixmap = other->pixmap;
+         bp->shared = 1;
+         return;
+      }
+   }
+
+   switch(bp->type) {
+   case BACKGROUND_SOLID:
+   case BACKGROUND_GRADIENT:
+      LoadGradientBackground(bp);
+      break;
+   case BACKGROUND_COMMAND:
+      /* Nothing to do. */
+      break;
+   case BACKGROUND_STRETCH:
+   case BACKGROUND_TILE:
+   case BACKGROUND_SCALE:
+      LoadImageBackground(bp);
+      break;
+   default:
+      Debug("invalid background type in LoadBackground: %d", bp->type);
+      break;
+   }
+}
+
+/** Decode the backgrounds of the desktops next to the current desktop.
+ * Images are decoded off the main loop; the pixmap is created by
+ * LoadBackground when the desktop is shown.
+ */
+void SignalBackground(const TimeType *now, int x, int y, Window w,
+                      void *data)
+{
+   const unsigned int count = settings.desktopCount;
+   const BackgroundNode *bp;
+
+   if(GetTimeDifference(now, &prefetchTime) < PREFETCH_DELAY) {
+      return;
+   }
+   UnregisterCallback(SignalBackground, NULL);
+   prefetchPending = 0;
+
+   bp = GetBackground((currentDesktop + 1) % count);
+   prefetched[0] = bp && !IsPixmapLoaded(bp) ? bp : NULL;
+   bp = GetBackground((currentDesktop + count - 1) % count);
+   prefetched[1] = bp && !IsPixmapLoaded(bp) ? bp : NULL;
+   if(prefetched[0]) {
+      PreloadBackground(prefetched[0], 0);
+   }
+   if(prefetched[1]) {
+      PreloadBackground(prefetched[1], 0);
+   }
+   DecodePreloadedImagesInBackground();
+}
+
+/** Cancel prefetched backgrounds that are no longer needed.
+ * Backgrounds that are still next to the specified desktop are kept.
+ */
+void DropPrefetched(int desktop)
+{
+   const unsigned int count = settings.desktopCount;
+   const BackgroundNode *next = GetBackground((desktop + 1) % count);
+   const BackgroundNode *prev = GetBackground((desktop + count - 1) % count);
+   unsigned int i;
+
+   for(i = 0; i < 2; i++) {
+      const BackgroundNode *bp = prefetched[i];
+      if(!bp) {
+         continue;
+      }
+      if(IsPixmapLoaded(bp)
+         || (!(next && IsSameBackground(bp, next))
+             && !(prev && IsSameBackground(bp, prev)))) {
+         PreloadBackground(bp, 1);
+         prefetched[i] = NULL;
+      }
+   }
+}
+
+/** Determine if two backgrounds look the same. */
+char IsSameBackground(const BackgroundNode *a, const BackgroundNode *b)
+{
+   return a->type == b->type && !strcmp(a->value, b->value);
+}
+
+/** Determine if a background already has a pixmap it can use. */
+char IsPixmapLoaded(const BackgroundNode *bp)
+{
+   const BackgroundNode *other;
+   for(other = backgrounds; other; other = other->next) {
+      if(other->loaded && IsSameBackground(other, bp)) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
 /** Load a gradient background. */
 void LoadGradientBackground(BackgroundNode *bp)
 {
@@ -298,9 +485,14 @@ void LoadImageBackground(BackgroundNode *bp)
    IconNode *ip;
    int width, height;
 
-   /* Load the icon. */
-   ExpandPath(&bp->value);
-   ip = LoadNamedIcon(bp->value, 0, bp->type == BACKGROUND_SCALE);
+   /* Load the icon, decoding it for the size of the root window unless
+    * it is tiled. */
+   if(bp->type == BACKGROUND_TILE) {
+      ip = LoadSizedIcon(bp->value, 0, 0, 0);
+   } else {
+      ip = LoadSizedIcon(bp->value, rootWidth, rootHeight,
+                         bp->type == BACKGROUND_SCALE);
+   }
    if(JUNLIKELY(!ip || ip->width == 0)) {
       bp->pixmap = None;
       Warning(_("background image not found: \"%s\""), bp->value);
@@ -12,11 +12,16 @@
 
 /*@{*/
 void InitializeBackgrounds(void);
-void StartupBackgrounds(void);
+#define StartupBackgrounds() (void)(0)
 void ShutdownBackgrounds(void);
 void DestroyBackgrounds(void);
 /*@}*/
 
+/** Request that the background image for the initial desktop be
+ * decoded ahead of time.
+ */
+void PreloadBackgrounds(void);
+
 /** Set the background to use for the specified desktops.
  * @param desktop The desktop whose background to set (-1 for the default).
  * @param type The type of background.
@@ -17,12 +17,40 @@
 #include "misc.h"
 #include "settings.h"
 #include "grab.h"
+#include "spatial.h"
+
+/** Status bits that affect the rendering of a title bar. */
+#define TITLE_STATUS_MASK (STAT_ACTIVE | STAT_FLASH | STAT_SHADED)
+
+/** Cached rendering of a title bar.
+ * The title bar is only rendered again if one of the inputs here changes.
+ */
+typedef struct TitleCache {
+   Pixmap canvas;             /**< The rendered title bar. */
+   GC gc;                     /**< Graphics context for the frame. */
+   unsigned int width;        /**< Width of the canvas. */
+   unsigned int height;       /**< Height of the canvas. */
+   int clientWidth;           /**< Width of the client. */
+   BorderFlags border;        /**< Border flags. */
+   MaxFlags maxFlags;         /**< Maximization flags. */
+   StatusFlags status;        /**< Status bits in TITLE_STATUS_MASK. */
+   char buttonsActive;        /**< Set if buttons were drawn active. */
+   const IconNode *icon;      /**< Icon for the menu button. */
+   char *title;               /**< The title text (NULL for none). */
+} TitleCache;
 
 static char *buttonNames[BI_COUNT];
 static IconNode *buttonIcons[BI_COUNT];
 
+static unsigned int titleCacheHits;
+static unsigned int titleCacheMisses;
+
 static char IsContextEnabled(MouseContextType context, const ClientNode *np);
 static void DrawBorderHelper(const ClientNode *np);
+static char *GetTitleText(const ClientNode *np);
+static char IsTitleCacheValid(const ClientNode *np, const char *title,
+                              unsigned int width, unsigned int height);
+static void DrawTitle(const ClientNode *np, const char *title);
 static void DrawBorderHandles(const ClientNode *np,
                               Pixmap canvas, GC gc);
 static void DrawBorderButton(const ClientNode *np, MouseContextType context,
@@ -80,6 +108,15 @@ void StartupBorders(void)
    }
 }
 
+/** Release server resources. */
+void ShutdownBorders(void)
+{
+   Debug("title cache: %u hits, %u misses",
+         titleCacheHits, titleCacheMisses);
+   titleCacheHits = 0;
+   titleCacheMisses = 0;
+}
+
 /** Destroy structures. */
 void DestroyBorders(void)
 {
@@ -257,6 +294,8 @@ void ResetBorder(const ClientNode *np)
    int north, south, east, west;
    int width, height;
 
+   UpdateClientIndex(np);
+
    if(np->parent == None) {
       JXMoveResizeWindow(display, np->window, np->x, np->y,
                          np->width, np->height);
@@ -378,6 +417,14 @@ void DrawBorder(ClientNode *np)
       return;
    }
 
+   /* Create the title bar cache if needed. */
+   if(np->titleCache == NULL) {
+      np->titleCache = Allocate(sizeof(TitleCache));
+      memset(np->titleCache, 0, sizeof(TitleCache));
+      np->titleCache->canvas = None;
+      np->titleCache->gc = NULL;
+   }
+
    /* Do the actual drawing. */
    DrawBorderHelper(np);
 
@@ -385,47 +432,194 @@ void DrawBorder(ClientNode *np)
 
 /** Helper method for drawing borders. */
 void DrawBorderHelper(const ClientNode *np)
+{
+   TitleCache *cache = np->titleCache;
+   long titleColor2;
+   long outlineColor;
+   int north, south, east, west;
+   unsigned int width, height;
+   char *title;
+
+   Assert(np);
+   Assert(cache);
+
+   GetBorderSize(&np->state, &north, &south, &east, &west);
+   width = np->width + east + west;
+   height = np->height + north + south;
+
+   /* Determine the colors to use. */
+   if(np->state.status & (STAT_ACTIVE | STAT_FLASH)) {
+      titleColor2 = colors[COLOR_TITLE_ACTIVE_BG2];
+      outlineColor = colors[COLOR_TITLE_ACTIVE_DOWN];
+   } else {
+      titleColor2 = colors[COLOR_TITLE_BG2];
+      outlineColor = colors[COLOR_TITLE_DOWN];
+   }
+
+   /* Set parent background to reduce flicker. */
+   JXSetWindowBackground(display, np->parent, titleColor2);
+
+   /* Render the title bar only if something it shows has changed. */
+   title = GetTitleText(np);
+   if(IsTitleCacheValid(np, title, width, north)) {
+      titleCacheHits += 1;
+      if(title) {
+         Release(title);
+      }
+   } else {
+      titleCacheMisses += 1;
+      if(cache->width != width || cache->height != north) {
+         if(cache->canvas != None) {
+            ReleaseStringContext(cache->canvas);
+            JXFreePixmap(display, cache->canvas);
+         }
+         cache->canvas = JXCreatePixmap(display, np->parent, width, north,
+                                        rootDepth);
+         cache->width = width;
+         cache->height = north;
+      }
+      if(cache->gc == NULL) {
+         cache->gc = JXCreateGC(display, cache->canvas, 0, NULL);
+      }
+      if(cache->title) {
+         Release(cache->title);
+      }
+      cache->title = title;
+      cache->clientWidth = np->width;
+      cache->border = np->state.border;
+      cache->maxFlags = np->state.maxFlags;
+      cache->status = np->state.status & TITLE_STATUS_MASK;
+      cache->buttonsActive = (np->state.status & STAT_ACTIVE)
+                           && IsClientOnCurrentDesktop(np);
+      cache->icon = np->icon;
+      DrawTitle(np, title);
+   }
+
+   /* Copy the pixmap for the title bar and clear the part of
+    * the window to be drawn directly. */
+   if(settings.windowDecorations == DECO_MOTIF) {
+      const int off = 2;
+      JXCopyArea(display, cache->canvas, np->parent, cache->gc, off, off,
+         width - 2 * off, north - off, off, off);
+      JXClearArea(display, np->parent,
+         off, north, width - 2 * off, height - north - off, False);
+   } else {
+      JXCopyArea(display, cache->canvas, np->parent, cache->gc, 1, 1,
+         width - 2, north - 1, 1, 1);
+      JXClearArea(display, np->parent,
+         1, north, width - 2, height - north - 1, False);
+   }
+
+   /* Window outline. */
+   if(settings.windowDecorations == DECO_MOTIF) {
+      DrawBorderHandles(np, np->parent, cache->gc);
+   } else {
+      const int radius
+         = (np->state.maxFlags && (np->state.border & BORDER_NOMAX))
+         ? 0 : settings.cornerRadius;
+      JXSetForeground(display, cache->gc, outlineColor);
+      if(np->state.status & STAT_SHADED) {
+         DrawRoundedRectangle(np->parent, cache->gc, 0, 0,
+                              width - 1, north - 1, radius);
+      } else {
+         DrawRoundedRectangle(np->parent, cache->gc, 0, 0,
+                              width - 1, height - 1, radius);
+      }
+   }
+
+}
+
+/** Get the text to show in the title bar of a client.
+ * Returns NULL if there is no title.
+ */
+char *GetTitleText(const ClientNode *np)
+{
+   char *titleBuffer;
+   if(!np->name || !np->name[0]) {
+      return NULL;
+   }
+   if(settings.showClientName && np->clientName && np->clientName[0]) {
+      /* Space for 2 delimiters, space, terminator, and strings */
+      const size_t buffSize = strlen(np->name) + strlen(np->clientName) + 4;
+      titleBuffer = Allocate(buffSize);
+      sprintf(titleBuffer, "%s %c%s%c", np->name,
+              settings.clientNameDelimiters[0], np->clientName,
+              settings.clientNameDelimiters[1]);
+   } else {
+      titleBuffer = CopyString(np->name);
+   }
+   return titleBuffer;
+}
+
+/** Determine if the cached title bar of a client can be reused. */
+char IsTitleCacheValid(const ClientNode *np, const char *title,
+                       unsigned int width, unsigned int height)
+{
+   const TitleCache *cache = np->titleCache;
+   const char buttonsActive = (np->state.status & STAT_ACTIVE)
+                            && IsClientOnCurrentDesktop(np);
+   if(cache->canvas == None) {
+      return 0;
+   }
+   if(cache->width != width || cache->height != height) {
+      return 0;
+   }
+   if(cache->clientWidth != np->width) {
+      return 0;
+   }
+   if(cache->border != np->state.border) {
+      return 0;
+   }
+   if(cache->maxFlags != np->state.maxFlags) {
+      return 0;
+   }
+   if(cache->status != (np->state.status & TITLE_STATUS_MASK)) {
+      return 0;
+   }
+   if(cache->buttonsActive != buttonsActive) {
+      return 0;
+   }
+   if(cache->icon != np->icon) {
+      return 0;
+   }
+   if(title == NULL || cache->title == NULL) {
+      return title == cache->title;
+   }
+   return strcmp(title, cache->title) == 0;
+}
+
+/** Render the title bar of a client to its cached canvas. */
+void DrawTitle(const ClientNode *np, const char *title)
 {
    ColorType borderTextColor;
 
    long titleColor1, titleColor2;
-   long outlineColor;
    GradientDirection gradient;
 
    int north, south, east, west;
-   unsigned int width, height;
+   unsigned int width;
    const int titleHeight = GetTitleHeight();
 
-   Pixmap canvas;
-   GC gc;
-
-   Assert(np);
+   const TitleCache *cache = np->titleCache;
+   const Pixmap canvas = cache->canvas;
+   const GC gc = cache->gc;
 
    GetBorderSize(&np->state, &north, &south, &east, &west);
    width = np->width + east + west;
-   height = np->height + north + south;
 
    /* Determine the colors and gradients to use. */
    if(np->state.status & (STAT_ACTIVE | STAT_FLASH)) {
       borderTextColor = COLOR_TITLE_ACTIVE_FG;
       titleColor1 = colors[COLOR_TITLE_ACTIVE_BG1];
       titleColor2 = colors[COLOR_TITLE_ACTIVE_BG2];
-      outlineColor = colors[COLOR_TITLE_ACTIVE_DOWN];
       gradient = gradients[COLOR_TITLE_ACTIVE_BG1];
    } else {
       borderTextColor = COLOR_TITLE_FG;
       titleColor1 = colors[COLOR_TITLE_BG1];
       titleColor2 = colors[COLOR_TITLE_BG2];
-      outlineColor = colors[COLOR_TITLE_DOWN];
       gradient = gradients[COLOR_TITLE_BG1];
    }
 
-   /* Set parent background to reduce flicker. */
-   JXSetWindowBackground(display, np->parent, titleColor2);
-
-   canvas = JXCreatePixmap(display, np->parent, width, north, rootDepth);
-   gc = JXCreateGC(display, canvas, 0, NULL);
-
    /* Clear the window with the right color. */
    JXSetForeground(display, gc, titleColor2);
    JXFillRectangle(display, canvas, gc, 0, 0, width, north);
@@ -450,21 +644,10 @@ void DrawBorderHelper(const ClientNode *np)
       point = DrawBorderButtons(np, canvas, gc);
 
       /* Draw the title. */
-      if(np->name && np->name[0] && point.x < point.y) {
+      if(title && point.x < point.y) {
          unsigned titleWidth = point.y - point.x;
          const int sheight = GetStringHeight(FONT_BORDER);
-         char *titleBuffer;
-         if (settings.showClientName && np->clientName && np->clientName[0]){
-             /* Space for 2 delimiters, space, terminator, and strings */
-             const size_t buffSize = strlen(np->name) + strlen(np->clientName) + 4;
-             titleBuffer = Allocate(buffSize);
-             sprintf(titleBuffer,"%s %c%s%c",np->name,
-                     settings.clientNameDelimiters[0],np->clientName,
-                     settings.clientNameDelimiters[1]);
-         } else {
-             titleBuffer = CopyString(np->name);
-         }
-         const int textWidth = GetStringWidth(FONT_BORDER,titleBuffer);
+         const int textWidth = GetStringWidth(FONT_BORDER, title);
          unsigned titlex, titley;
          int xoffset = 0;
 
@@ -487,47 +670,31 @@ void DrawBorderHelper(const ClientNode *np)
             titley += south - 1;
          }
          RenderString(canvas, FONT_BORDER, borderTextColor,
-                      titlex, titley, titleWidth, titleBuffer);
-         Release(titleBuffer);
+                      titlex, titley, titleWidth, title);
       }
 
    }
 
-   /* Copy the pixmap for the title bar and clear the part of
-    * the window to be drawn directly. */
-   if(settings.windowDecorations == DECO_MOTIF) {
-      const int off = 2;
-      JXCopyArea(display, canvas, np->parent, gc, off, off,
-         width - 2 * off, north - off, off, off);
-      JXClearArea(display, np->parent,
-         off, north, width - 2 * off, height - north - off, False);
-   } else {
-      JXCopyArea(display, canvas, np->parent, gc, 1, 1,
-         width - 2, north - 1, 1, 1);
-      JXClearArea(display, np->parent,
-         1, north, width - 2, height - north - 1, False);
-   }
+}
 
-   /* Window outline. */
-   if(settings.windowDecorations == DECO_MOTIF) {
-      DrawBorderHandles(np, np->parent, gc);
-   } else {
-      const int radius
-         = (np->state.maxFlags && (np->state.border & BORDER_NOMAX))
-         ? 0 : settings.cornerRadius;
-      JXSetForeground(display, gc, outlineColor);
-      if(np->state.status & STAT_SHADED) {
-         DrawRoundedRectangle(np->parent, gc, 0, 0, width - 1, north - 1,
-                              radius);
-      } else {
-         DrawRoundedRectangle(np->parent, gc, 0, 0, width - 1, height - 1,
-                              radius);
+/** Release the cached title bar of a client. */
+void ReleaseTitleCache(ClientNode *np)
+{
+   TitleCache *cache = np->titleCache;
+   if(cache) {
+      if(cache->canvas != None) {
+         ReleaseStringContext(cache->canvas);
+         JXFreePixmap(display, cache->canvas);
       }
+      if(cache->gc != NULL) {
+         JXFreeGC(display, cache->gc);
+      }
+      if(cache->title) {
+         Release(cache->title);
+      }
+      Release(cache);
+      np->titleCache = NULL;
    }
-
-   JXFreePixmap(display, canvas);
-   JXFreeGC(display, gc);
-
 }
 
 /** Draw window handles. */
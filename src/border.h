@@ -33,7 +33,7 @@ typedef unsigned char BorderIconType;
 /*@{*/
 void InitializeBorders(void);
 void StartupBorders(void);
-#define ShutdownBorders()      (void)(0)
+void ShutdownBorders(void);
 void DestroyBorders(void);
 /*@}*/
 
@@ -56,6 +56,13 @@ void ResetBorder(const struct ClientNode *np);
  */
 void DrawBorder(struct ClientNode *np);
 
+/** Release the cached title bar of a client.
+ * This must be called before a client is destroyed and when an input
+ * to the title bar that is not tracked by the cache (the icon) changes.
+ * @param np The client.
+ */
+void ReleaseTitleCache(struct ClientNode *np);
+
 /** Get the size of a border icon.
  * @return The size in pixels (note that icons are square).
  */
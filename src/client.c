@@ -25,9 +25,25 @@
 #include "timing.h"
 #include "grab.h"
 #include "desktop.h"
+#include "spatial.h"
+#include "misc.h"
+
+/** Largest range of changed windows restacked one window at a time. */
+#define RESTACK_LIMIT 64
 
 static ClientNode *activeClient;
 
+/* The stacking order last sent to the server (top to bottom). */
+static Window *lastStack = NULL;
+static unsigned int lastStackCount;
+static unsigned int lastStackSize;
+static char lastStackValid;
+
+/* Restacking statistics. */
+static unsigned int fullRestacks;
+static unsigned int partialRestacks;
+static unsigned long restackedWindows;
+
 unsigned int clientCount;
 
 static void LoadFocus(void);
@@ -36,6 +52,12 @@ static void MinimizeTransients(ClientNode *np, char lower);
 static void RestoreTransients(ClientNode *np, char raise);
 static void KillClientHandler(ClientNode *np);
 static void UnmapClient(ClientNode *np);
+static ClientNode *GetTransients(Window owner);
+static ClientNode *GetNextOwned(ClientNode *np, ClientNode *tp);
+static void ApplyStack(const Window *stack, unsigned int count);
+static char ApplyStackChanges(const Window *stack, unsigned int count,
+                              unsigned int *touched);
+static void MoveStackWindow(Window w, Window sibling, int mode);
 
 /** Load windows that are already mapped. */
 void StartupClients(void)
@@ -50,6 +72,11 @@ void StartupClients(void)
    activeClient = NULL;
    currentDesktop = 0;
    previousDesktop = 0;
+   lastStackCount = 0;
+   lastStackValid = 0;
+   fullRestacks = 0;
+   partialRestacks = 0;
+   restackedWindows = 0;
 
    /* Clear out the client lists. */
    for(x = 0; x < LAYER_COUNT; x++) {
@@ -61,12 +88,28 @@ void StartupClients(void)
    JXQueryTree(display, rootWindow, &rootReturn, &parentReturn,
                &childrenReturn, &childrenCount);
 
+   /* Request the attributes of all windows at once.
+    * Then request the properties for all windows we will manage
+    * so that adding them does not wait on the server. */
+   for(x = 0; x < childrenCount; x++) {
+      PrefetchWindowAttributes(childrenReturn[x]);
+   }
+   for(x = 0; x < childrenCount; x++) {
+      const Window w = childrenReturn[x];
+      if(JXGetWindowAttributes(display, w, &attr)
+         && attr.override_redirect == False
+         && attr.map_state == IsViewable) {
+         PrefetchClientInfo(w);
+      } else {
+         childrenReturn[x] = None;
+         ReleasePrefetchedWindow(w);
+      }
+   }
+
    /* Add each client. */
    for(x = 0; x < childrenCount; x++) {
-      if(JXGetWindowAttributes(display, childrenReturn[x], &attr)) {
-         if(attr.override_redirect == False && attr.map_state == IsViewable) {
-            AddClientWindow(childrenReturn[x], 1, 1);
-         }
+      if(childrenReturn[x] != None) {
+         AddClientWindow(childrenReturn[x], 1, 1);
       }
    }
 
@@ -91,6 +134,14 @@ void ShutdownClients(void)
       }
    }
 
+   Debug("restacks: %u full, %u incremental, %lu windows touched",
+         fullRestacks, partialRestacks, restackedWindows);
+   if(lastStack) {
+      Release(lastStack);
+      lastStack = NULL;
+   }
+   lastStackSize = 0;
+
 }
 
 /** Set the focus to the window currently under the mouse pointer. */
@@ -122,16 +173,20 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
 
    Assert(w != None);
 
+   /* Request the attributes and client properties up front so that
+    * their replies arrive together. */
+   PrefetchWindowAttributes(w);
+   PrefetchClientInfo(w);
+
    /* Get window attributes. */
    if(JXGetWindowAttributes(display, w, &attr) == 0) {
+      ReleasePrefetchedWindow(w);
       return NULL;
    }
 
    /* Determine if we should care about this window. */
-   if(attr.override_redirect == True) {
-      return NULL;
-   }
-   if(attr.class == InputOnly) {
+   if(attr.override_redirect == True || attr.class == InputOnly) {
+      ReleasePrefetchedWindow(w);
       return NULL;
    }
 
@@ -180,6 +235,7 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
       nodeTail[np->state.layer] = np;
    }
    nodes[np->state.layer] = np;
+   InsertClientIndex(np);
 
    if(notOwner) {
       XSetWindowAttributes sattr;
@@ -278,6 +334,8 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
    }
    ResetBorder(np);
 
+   ReleasePrefetchedWindow(w);
+
    return np;
 }
 
@@ -295,7 +353,6 @@ void MinimizeTransients(ClientNode *np, char lower)
 {
 
    ClientNode *tp;
-   int x;
 
    Assert(np);
 
@@ -309,16 +366,10 @@ void MinimizeTransients(ClientNode *np, char lower)
    np->state.status |= STAT_MINIMIZED;
 
    /* Minimize transient windows. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      tp = nodes[x];
-      while(tp) {
-         ClientNode *next = tp->next;
-         if(tp->owner == np->window
-            && (tp->state.status & (STAT_MAPPED | STAT_SHADED))
-            && !(tp->state.status & STAT_MINIMIZED)) {
-            MinimizeTransients(tp, lower);
-         }
-         tp = next;
+   for(tp = GetTransients(np->window); tp; tp = tp->nextTransient) {
+      if(   (tp->state.status & (STAT_MAPPED | STAT_SHADED))
+         && !(tp->state.status & STAT_MINIMIZED)) {
+         MinimizeTransients(tp, lower);
       }
    }
 
@@ -431,7 +482,6 @@ void RestoreTransients(ClientNode *np, char raise)
 {
 
    ClientNode *tp;
-   int x;
 
    Assert(np);
 
@@ -456,11 +506,9 @@ void RestoreTransients(ClientNode *np, char raise)
    np->state.status &= ~STAT_SDESKTOP;
 
    /* Restore transient windows. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(tp = nodes[x]; tp; tp = tp->next) {
-         if(tp->owner == np->window && (tp->state.status & STAT_MINIMIZED)) {
-            RestoreTransients(tp, raise);
-         }
+   for(tp = GetTransients(np->window); tp; tp = tp->nextTransient) {
+      if(tp->state.status & STAT_MINIMIZED) {
+         RestoreTransients(tp, raise);
       }
    }
 
@@ -487,50 +535,42 @@ void RestoreClient(ClientNode *np, char raise)
 void SetClientLayer(ClientNode *np, unsigned int layer)
 {
 
-   ClientNode *tp, *next;
+   ClientNode *tp;
 
    Assert(np);
    Assert(layer <= LAST_LAYER);
 
    if(np->state.layer != layer) {
-      int x;
-
-      /* Loop through all clients so we get transients. */
-      for(x = FIRST_LAYER; x <= LAST_LAYER; x++) {
-         tp = nodes[x];
-         while(tp) {
-            next = tp->next;
-            if(tp == np || tp->owner == np->window) {
-
-               /* Remove from the old node list */
-               if(next) {
-                  next->prev = tp->prev;
-               } else {
-                  nodeTail[tp->state.layer] = tp->prev;
-               }
-               if(tp->prev) {
-                  tp->prev->next = next;
-               } else {
-                  nodes[tp->state.layer] = next;
-               }
 
-               /* Insert into the new node list */
-               tp->prev = NULL;
-               tp->next = nodes[layer];
-               if(nodes[layer]) {
-                  nodes[layer]->prev = tp;
-               } else {
-                  nodeTail[layer] = tp;
-               }
-               nodes[layer] = tp;
+      /* Move the client and its transients. */
+      for(tp = np; tp; tp = GetNextOwned(np, tp)) {
 
-               /* Set the new layer */
-               tp->state.layer = layer;
-               WriteState(tp);
+         /* Remove from the old node list */
+         if(tp->next) {
+            tp->next->prev = tp->prev;
+         } else {
+            nodeTail[tp->state.layer] = tp->prev;
+         }
+         if(tp->prev) {
+            tp->prev->next = tp->next;
+         } else {
+            nodes[tp->state.layer] = tp->next;
+         }
 
-            }
-            tp = next;
+         /* Insert into the new node list */
+         tp->prev = NULL;
+         tp->next = nodes[layer];
+         if(nodes[layer]) {
+            nodes[layer]->prev = tp;
+         } else {
+            nodeTail[layer] = tp;
          }
+         nodes[layer] = tp;
+
+         /* Set the new layer */
+         tp->state.layer = layer;
+         WriteState(tp);
+
       }
 
       RequireRestack();
@@ -544,7 +584,6 @@ void SetClientSticky(ClientNode *np, char isSticky)
 {
 
    ClientNode *tp;
-   int x;
    char old;
 
    Assert(np);
@@ -560,27 +599,19 @@ void SetClientSticky(ClientNode *np, char isSticky)
 
       /* Change from non-sticky to sticky. */
 
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
-               tp->state.status |= STAT_STICKY;
-               SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP, ~0UL);
-               WriteState(tp);
-            }
-         }
+      for(tp = np; tp; tp = GetNextOwned(np, tp)) {
+         tp->state.status |= STAT_STICKY;
+         SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP, ~0UL);
+         WriteState(tp);
       }
 
    } else if(!isSticky && old) {
 
       /* Change from sticky to non-sticky. */
 
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
-               tp->state.status &= ~STAT_STICKY;
-               WriteState(tp);
-            }
-         }
+      for(tp = np; tp; tp = GetNextOwned(np, tp)) {
+         tp->state.status &= ~STAT_STICKY;
+         WriteState(tp);
       }
 
       /* Since this client is no longer sticky, we need to assign
@@ -606,23 +637,19 @@ void SetClientDesktop(ClientNode *np, unsigned int desktop)
    }
 
    if(!(np->state.status & STAT_STICKY)) {
-      int x;
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
+      for(tp = np; tp; tp = GetNextOwned(np, tp)) {
 
-               tp->state.desktop = desktop;
-
-               if(desktop == currentDesktop) {
-                  ShowClient(tp);
-               } else {
-                  HideClient(tp);
-               }
+         tp->state.desktop = desktop;
+         UpdateClientIndex(tp);
 
-               SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP,
-                               tp->state.desktop);
-            }
+         if(desktop == currentDesktop) {
+            ShowClient(tp);
+         } else {
+            HideClient(tp);
          }
+
+         SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP,
+                         tp->state.desktop);
       }
       RequirePagerUpdate();
       RequireTaskUpdate();
@@ -906,39 +933,27 @@ void KillClient(ClientNode *np)
       NULL);
 }
 
-/** Place transients on top of the owner. */
+/** Place transients on top of the owner.
+ * Transients are moved in the order they were added so that the
+ * newest ends up on top.
+ */
 void RestackTransients(const ClientNode *np)
 {
    ClientNode *tp;
-   unsigned int layer;
-
-   /* Place any transient windows on top of the owner */
-   for(layer = 0; layer < LAYER_COUNT; layer++) {
-      for(tp = nodes[layer]; tp; tp = tp->next) {
-         if(tp->owner == np->window && tp->prev) {
-
-            ClientNode *next = tp->next;
-
-            tp->prev->next = tp->next;
-            if(tp->next) {
-               tp->next->prev = tp->prev;
-            } else {
-               nodeTail[tp->state.layer] = tp->prev;
-            }
-            tp->next = nodes[tp->state.layer];
-            nodes[tp->state.layer]->prev = tp;
-            tp->prev = NULL;
-            nodes[tp->state.layer] = tp;
-
-            tp = next;
 
+   for(tp = GetTransients(np->window); tp; tp = tp->nextTransient) {
+      if(tp->prev) {
+         const unsigned int layer = tp->state.layer;
+         tp->prev->next = tp->next;
+         if(tp->next) {
+            tp->next->prev = tp->prev;
+         } else {
+            nodeTail[layer] = tp->prev;
          }
-
-         /* tp will be tp->next if the above code is executed. */
-         /* Thus, if it is NULL, we are done with this layer. */
-         if(!tp) {
-            break;
-         }
+         tp->next = nodes[layer];
+         nodes[layer]->prev = tp;
+         tp->prev = NULL;
+         nodes[layer] = tp;
       }
    }
 }
@@ -1102,7 +1117,11 @@ void RestackClients(void)
    index = 0;
    if(activeClient && (activeClient->state.status & STAT_FULLSCREEN)) {
       fw = activeClient->window;
-      for(np = nodes[activeClient->state.layer]; np; np = np->next) {
+
+      /* Transients go above the window in their stacking order.
+       * The layer is only scanned if the window has transients. */
+      np = GetTransients(fw) ? nodes[activeClient->state.layer] : NULL;
+      for(; np; np = np->next) {
          if(np->owner == fw) {
             if(np->parent != None) {
                stack[index] = np->parent;
@@ -1151,14 +1170,224 @@ void RestackClients(void)
 
    }
 
-   JXRestackWindows(display, stack, index);
+   ApplyStack(stack, index);
 
    ReleaseStack(stack);
-   UpdateNetClientList();
+   RequireClientListUpdate();
    RequirePagerUpdate();
 
 }
 
+/** Get the first transient of an owner window. */
+ClientNode *GetTransients(Window owner)
+{
+   ClientNode *np;
+   if(!XFindContext(display, owner, transientContext, (void*)&np)) {
+      return np;
+   } else {
+      return NULL;
+   }
+}
+
+/** Get the next client when visiting a client and its transients.
+ * Start with the client itself; NULL is returned after the last one.
+ */
+ClientNode *GetNextOwned(ClientNode *np, ClientNode *tp)
+{
+   tp = (tp == np) ? GetTransients(np->window) : tp->nextTransient;
+   if(tp == np) {
+      /* Don't visit a client listed as its own transient twice. */
+      tp = tp->nextTransient;
+   }
+   return tp;
+}
+
+/** Set the owner of a client. */
+void SetClientOwner(ClientNode *np, Window owner)
+{
+   ClientNode *tp;
+
+   /* Remove from the list for the old owner. */
+   if(np->owner != None) {
+      if(np->prevTransient) {
+         np->prevTransient->nextTransient = np->nextTransient;
+      } else if(np->nextTransient) {
+         XSaveContext(display, np->owner, transientContext,
+                      (void*)np->nextTransient);
+      } else {
+         XDeleteContext(display, np->owner, transientContext);
+      }
+      if(np->nextTransient) {
+         np->nextTransient->prevTransient = np->prevTransient;
+      }
+   }
+   np->owner = owner;
+   np->prevTransient = NULL;
+   np->nextTransient = NULL;
+
+   /* Add to the end of the list for the new owner. */
+   if(owner != None) {
+      tp = GetTransients(owner);
+      if(tp) {
+         while(tp->nextTransient) {
+            tp = tp->nextTransient;
+         }
+         tp->nextTransient = np;
+         np->prevTransient = tp;
+      } else {
+         XSaveContext(display, owner, transientContext, (void*)np);
+      }
+   }
+}
+
+/** Send a stacking order to the server.
+ * Only the windows that moved since the last restack are restacked
+ * unless the change is too large or the server stack is unknown.
+ */
+void ApplyStack(const Window *stack, unsigned int count)
+{
+   unsigned int touched;
+
+   if(lastStackValid && ApplyStackChanges(stack, count, &touched)) {
+      partialRestacks += 1;
+   } else {
+      JXRestackWindows(display, (Window*)stack, count);
+      touched = count > 0 ? count - 1 : 0;
+      fullRestacks += 1;
+   }
+   restackedWindows += touched;
+
+   /* Remember the stacking order for the next restack. */
+   if(count > lastStackSize) {
+      lastStackSize = Max(count, lastStackSize * 2);
+      lastStack = Reallocate(lastStack, lastStackSize * sizeof(Window));
+   }
+   if(count > 0) {
+      memcpy(lastStack, stack, count * sizeof(Window));
+   }
+   lastStackCount = count;
+   lastStackValid = 1;
+}
+
+/** Restack only the windows that moved since the last restack.
+ * Windows that kept their relative order (the longest such run within
+ * the changed range) stay where they are and the others are placed
+ * next to a window that is already in its final position.
+ * @return 1 on success, 0 if a full restack is needed.
+ */
+char ApplyStackChanges(const Window *stack, unsigned int count,
+                       unsigned int *touched)
+{
+   int position[RESTACK_LIMIT];
+   int length[RESTACK_LIMIT];
+   int previous[RESTACK_LIMIT];
+   char stable[RESTACK_LIMIT];
+   unsigned int first, last, oldLast;
+   unsigned int anchor;
+   unsigned int i, j;
+   int best;
+
+   *touched = 0;
+
+   /* Skip the windows at the top and bottom that did not change. */
+   first = 0;
+   while(first < count && first < lastStackCount
+         && stack[first] == lastStack[first]) {
+      first += 1;
+   }
+   last = count;
+   oldLast = lastStackCount;
+   while(last > first && oldLast > first
+         && stack[last - 1] == lastStack[oldLast - 1]) {
+      last -= 1;
+      oldLast -= 1;
+   }
+   if(last == first) {
+      return 1;
+   }
+   if(last - first > RESTACK_LIMIT || oldLast - first > RESTACK_LIMIT) {
+      return 0;
+   }
+
+   /* Find the old position of each window in the changed range. */
+   for(i = first; i < last; i++) {
+      position[i - first] = -1;
+      for(j = first; j < oldLast; j++) {
+         if(lastStack[j] == stack[i]) {
+            position[i - first] = j;
+            break;
+         }
+      }
+   }
+
+   /* Find the longest run of windows that kept their relative order. */
+   best = -1;
+   for(i = 0; i < last - first; i++) {
+      length[i] = 0;
+      previous[i] = -1;
+      stable[i] = 0;
+      if(position[i] < 0) {
+         continue;
+      }
+      length[i] = 1;
+      for(j = 0; j < i; j++) {
+         if(position[j] >= 0 && position[j] < position[i]
+            && length[j] + 1 > length[i]) {
+            length[i] = length[j] + 1;
+            previous[i] = j;
+         }
+      }
+      if(best < 0 || length[i] > length[best]) {
+         best = i;
+      }
+   }
+   for(; best >= 0; best = previous[best]) {
+      stable[best] = 1;
+   }
+
+   /* Windows above the first stable window are placed bottom up. */
+   anchor = first;
+   if(first == 0) {
+      while(anchor < last && !stable[anchor - first]) {
+         anchor += 1;
+      }
+      if(anchor == count) {
+         /* Nothing to place the windows against. */
+         return 0;
+      }
+      for(i = anchor; i > 0; i--) {
+         MoveStackWindow(stack[i - 1], stack[i], Above);
+         *touched += 1;
+      }
+      anchor += 1;
+   }
+
+   /* The remaining windows are placed top down. */
+   for(i = anchor; i < last; i++) {
+      if(!stable[i - first]) {
+         MoveStackWindow(stack[i], stack[i - 1], Below);
+         *touched += 1;
+      }
+   }
+
+   return 1;
+}
+
+/** Place a window directly above or below a sibling. */
+void MoveStackWindow(Window w, Window sibling, int mode)
+{
+   XWindowChanges changes;
+   changes.sibling = sibling;
+   changes.stack_mode = mode;
+   JXConfigureWindow(display, w, CWSibling | CWStackMode, &changes);
+}
+
+/** Note that windows were restacked without RestackClients. */
+void InvalidateRestack(void)
+{
+   lastStackValid = 0;
+}
+
 /** Send a client message to a window. */
 void SendClientMessage(Window w, AtomType type, AtomType message)
 {
@@ -1201,6 +1430,8 @@ void RemoveClient(ClientNode *np)
    } else {
       nodes[np->state.layer] = np->next;
    }
+   RemoveClientIndex(np);
+   SetClientOwner(np, None);
    clientCount -= 1;
    XDeleteContext(display, np->window, clientContext);
    if(np->parent != None) {
@@ -1255,10 +1486,10 @@ void RemoveClient(ClientNode *np)
       Release(np->name);
    }
    if(np->instanceName) {
-      JXFree(np->instanceName);
+      Release(np->instanceName);
    }
    if(np->className) {
-      JXFree(np->className);
+      Release(np->className);
    }
    if(np->clientName) {
       Release(np->clientName);
@@ -1274,6 +1505,7 @@ void RemoveClient(ClientNode *np)
    }
 
    DestroyIcon(np->icon);
+   ReleaseTitleCache(np);
 
    Release(np);
 
@@ -1412,6 +1644,8 @@ void SendConfigureEvent(ClientNode *np)
 
    Assert(np);
 
+   UpdateClientIndex(np);
+
    memset(&event, 0, sizeof(event));
    event.display = display;
    event.type = ConfigureNotify;
@@ -121,6 +121,10 @@ typedef struct ClientNode {
 
    Window owner;              /**< The owner window (for transients). */
 
+   /** Other transients of the same owner (see SetClientOwner). */
+   struct ClientNode *prevTransient;
+   struct ClientNode *nextTransient;
+
    int x, y;                  /**< The location of the window. */
    int width;                 /**< The width of the window. */
    int height;                /**< The height of the window. */
@@ -158,6 +162,15 @@ typedef struct ClientNode {
    /** Callback to stop move/resize. */
    void (*controller)(int wasDestroyed);
 
+   /** Location of this client in the spatial index. */
+   struct SpatialEntry *spatial;
+
+   /** Cached rendering of the title bar (see border.c). */
+   struct TitleCache *titleCache;
+
+   /** Entry for this client in the task list (see taskbar.c). */
+   struct ClientEntry *taskEntry;
+
    struct ClientNode *prev;   /**< The previous client in this layer. */
    struct ClientNode *next;   /**< The next client in this layer. */
 
@@ -292,6 +305,19 @@ void RestackClient(ClientNode *np, Window above, int detail);
  */
 void RestackClients(void);
 
+/** Set the owner of a client (for transients).
+ * The transients of each owner window are kept in a list so that
+ * operations on an owner don't need to search every client.
+ * @param np The client.
+ * @param owner The owner window (None if the client is not a transient).
+ */
+void SetClientOwner(ClientNode *np, Window owner);
+
+/** Note that windows were restacked without RestackClients.
+ * The next restack will send the whole stacking order to the server.
+ */
+void InvalidateRestack(void);
+
 /** Set the layer of a client.
  * @param np The client whose layer to set.
  * @param layer the layer to assign to the client.
@@ -182,6 +182,7 @@ void WalkWindowStack(char forward)
             wasMinimized = 0;
          }
          JXRaiseWindow(display, np->parent ? np->parent : np->window);
+         InvalidateRestack();
          FocusClient(np);
          break;
 
@@ -183,6 +183,7 @@ void Resize(TrayComponentType *cp)
    Assert(clk);
 
    if(cp->pixmap != None) {
+      ReleaseStringContext(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 
@@ -201,6 +202,7 @@ void Destroy(TrayComponentType *cp)
 {
    Assert(cp);
    if(cp->pixmap != None) {
+      ReleaseStringContext(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 }
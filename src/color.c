@@ -14,6 +14,14 @@
 #include "misc.h"
 #include "settings.h"
 
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 /** Mapping between color types and default values. */
 typedef struct {
    ColorType type;
@@ -168,11 +176,19 @@ static unsigned greenBits;
 static unsigned blueBits;
 static unsigned long alphaMask;
 
+/* Set if pixels can be packed directly (8 bits per component). */
+static char packDirect;
+
+/* Byte order of the host (LSBFirst or MSBFirst). */
+static int hostByteOrder;
+
 static unsigned ComputeShift(unsigned long maskIn, unsigned *shiftOut);
 static unsigned long GetRGBFromXColor(const XColor *c);
 
 static unsigned long GetDirectPixel(const XColor *c);
 static void GetMappedPixel(XColor *c);
+static void PackDirectRow(uint32_t *dest, const unsigned char *argb,
+                          unsigned int width, char premultiply);
 static void AllocateColor(ColorType type, XColor *c);
 
 static unsigned long ReadHex(const char *hex);
@@ -187,6 +203,7 @@ static void DarkenColor(ColorType oldColor, ColorType newColor);
 /** Startup color support. */
 void StartupColors(void)
 {
+   const unsigned int one = 1;
    unsigned int x;
    XColor c;
 
@@ -205,6 +222,7 @@ void StartupColors(void)
                 & ~(((1UL << greenBits) - 1) << greenShift)
                 & ~(((1UL << blueBits ) - 1) << blueShift);
       rgbToPixel = NULL;
+      packDirect = redBits == 8 && greenBits == 8 && blueBits == 8;
       break;
    default:
       /* Restrict icons to 64 colors (RGB 2, 2, 2). */
@@ -214,8 +232,10 @@ void StartupColors(void)
       alphaMask = 0;
       rgbToPixel = Allocate(sizeof(unsigned long) * MAX_COLORS);
       memset(rgbToPixel, 0xFF, sizeof(unsigned long) * MAX_COLORS);
+      packDirect = 0;
       break;
    }
+   hostByteOrder = *(const char*)&one ? LSBFirst : MSBFirst;
 
    /* Inherit colors. */
    if(names) {
@@ -513,6 +533,136 @@ void GetColor(XColor *c)
    }
 }
 
+/** Convert a row of ARGB data to pixels. */
+void PutColorRow(XImage *image, int y, const unsigned char *argb,
+                 unsigned int width, char premultiply)
+{
+   XColor color;
+   unsigned int x;
+
+   if(packDirect && image->bits_per_pixel == 32
+      && image->byte_order == hostByteOrder) {
+      char *line = image->data + y * image->bytes_per_line;
+      PackDirectRow((uint32_t*)line, argb, width, premultiply);
+      return;
+   }
+
+   for(x = 0; x < width; x++) {
+      const unsigned long alpha = argb[0];
+      color.red = argb[1];
+      color.red |= color.red << 8;
+      color.green = argb[2];
+      color.green |= color.green << 8;
+      color.blue = argb[3];
+      color.blue |= color.blue << 8;
+      if(premultiply) {
+         color.red = (color.red * alpha) >> 8;
+         color.green = (color.green * alpha) >> 8;
+         color.blue = (color.blue * alpha) >> 8;
+      }
+      GetColor(&color);
+      XPutPixel(image, x, y, color.pixel);
+      argb += 4;
+   }
+}
+
+/** Pack a row of ARGB data into 32-bit pixels.
+ * This gives the same result as GetDirectPixel for 8-bit components.
+ * Premultiplication computes (v * 257 * a) >> 16 as (t + (t >> 8)) >> 8
+ * with t = v * a, which stays within 16 bits.
+ */
+void PackDirectRow(uint32_t *dest, const unsigned char *argb,
+                   unsigned int width, char premultiply)
+{
+   const uint32_t alpha = (uint32_t)alphaMask;
+   unsigned int x = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+   if(hostByteOrder == LSBFirst) {
+#  if defined(__AVX2__)
+      const __m256i byteMask = _mm256_set1_epi32(0xFF);
+      const __m256i extra = _mm256_set1_epi32((int)alpha);
+      const __m128i rs = _mm_cvtsi32_si128(redShift);
+      const __m128i gs = _mm_cvtsi32_si128(greenShift);
+      const __m128i bs = _mm_cvtsi32_si128(blueShift);
+      for(; x + 8 <= width; x += 8) {
+         const __m256i v = _mm256_loadu_si256((const __m256i*)argb);
+         __m256i r = _mm256_and_si256(_mm256_srli_epi32(v, 8), byteMask);
+         __m256i g = _mm256_and_si256(_mm256_srli_epi32(v, 16), byteMask);
+         __m256i b = _mm256_srli_epi32(v, 24);
+         __m256i p;
+         if(premultiply) {
+            const __m256i a = _mm256_and_si256(v, byteMask);
+            r = _mm256_mullo_epi16(r, a);
+            g = _mm256_mullo_epi16(g, a);
+            b = _mm256_mullo_epi16(b, a);
+            r = _mm256_add_epi16(r, _mm256_srli_epi16(r, 8));
+            g = _mm256_add_epi16(g, _mm256_srli_epi16(g, 8));
+            b = _mm256_add_epi16(b, _mm256_srli_epi16(b, 8));
+            r = _mm256_srli_epi16(r, 8);
+            g = _mm256_srli_epi16(g, 8);
+            b = _mm256_srli_epi16(b, 8);
+         }
+         p = _mm256_or_si256(_mm256_sll_epi32(r, rs), extra);
+         p = _mm256_or_si256(p, _mm256_sll_epi32(g, gs));
+         p = _mm256_or_si256(p, _mm256_sll_epi32(b, bs));
+         _mm256_storeu_si256((__m256i*)&dest[x], p);
+         argb += 32;
+      }
+#  else
+      const __m128i byteMask = _mm_set1_epi32(0xFF);
+      const __m128i extra = _mm_set1_epi32((int)alpha);
+      const __m128i rs = _mm_cvtsi32_si128(redShift);
+      const __m128i gs = _mm_cvtsi32_si128(greenShift);
+      const __m128i bs = _mm_cvtsi32_si128(blueShift);
+      for(; x + 4 <= width; x += 4) {
+         const __m128i v = _mm_loadu_si128((const __m128i*)argb);
+         __m128i r = _mm_and_si128(_mm_srli_epi32(v, 8), byteMask);
+         __m128i g = _mm_and_si128(_mm_srli_epi32(v, 16), byteMask);
+         __m128i b = _mm_srli_epi32(v, 24);
+         __m128i p;
+         if(premultiply) {
+            const __m128i a = _mm_and_si128(v, byteMask);
+            r = _mm_mullo_epi16(r, a);
+            g = _mm_mullo_epi16(g, a);
+            b = _mm_mullo_epi16(b, a);
+            r = _mm_add_epi16(r, _mm_srli_epi16(r, 8));
+            g = _mm_add_epi16(g, _mm_srli_epi16(g, 8));
+            b = _mm_add_epi16(b, _mm_srli_epi16(b, 8));
+            r = _mm_srli_epi16(r, 8);
+            g = _mm_srli_epi16(g, 8);
+            b = _mm_srli_epi16(b, 8);
+         }
+         p = _mm_or_si128(_mm_sll_epi32(r, rs), extra);
+         p = _mm_or_si128(p, _mm_sll_epi32(g, gs));
+         p = _mm_or_si128(p, _mm_sll_epi32(b, bs));
+         _mm_storeu_si128((__m128i*)&dest[x], p);
+         argb += 16;
+      }
+#  endif
+   }
+#endif
+
+   /* Scalar fallback (and the remainder of the row). */
+   for(; x < width; x++) {
+      uint32_t r = argb[1];
+      uint32_t g = argb[2];
+      uint32_t b = argb[3];
+      if(premultiply) {
+         const uint32_t a = argb[0];
+         r *= a;
+         g *= a;
+         b *= a;
+         r = (r + (r >> 8)) >> 8;
+         g = (g + (g >> 8)) >> 8;
+         b = (b + (b >> 8)) >> 8;
+      }
+      dest[x] = (r << redShift) | (g << greenShift) | (b << blueShift)
+              | alpha;
+      argb += 4;
+   }
+}
+
 /** Get an XFT color for the specified component. */
 #ifdef USE_XFT
 XftColor *GetXftColor(ColorType type)
@@ -124,6 +124,18 @@ char ParseColor(const char *value, XColor *c);
  */
 void GetColor(XColor *c);
 
+/** Convert a row of ARGB data to pixels in an XImage.
+ * On 24/32-bit TrueColor visuals the pixels are packed directly into
+ * the image data; other visuals go through GetColor.
+ * @param image The image (using the root visual and depth).
+ * @param y The row of the image to fill.
+ * @param argb The source data (alpha, red, green, blue bytes per pixel).
+ * @param width The number of pixels to convert.
+ * @param premultiply Set to scale the color components by alpha.
+ */
+void PutColorRow(XImage *image, int y, const unsigned char *argb,
+                 unsigned int width, char premultiply);
+
 #ifdef USE_XFT
 /** Get an XFT color.
  * @param type The color whose XFT color to get.
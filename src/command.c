@@ -13,6 +13,7 @@
 #include "main.h"
 #include "error.h"
 #include "timing.h"
+#include "event.h"
 
 #include <fcntl.h>
 #include <errno.h>
@@ -131,6 +132,7 @@ void RunCommand(const char *command)
    displayString = DisplayString(display);
    if(!fork()) {
       close(ConnectionNumber(display));
+      ResetSignalMask();
       if(displayString && displayString[0]) {
          const size_t var_len = strlen(displayString) + 9;
          char *str = malloc(var_len);
@@ -168,6 +170,7 @@ char *ReadFromProcess(const char *command, unsigned timeout_ms)
       if(display) {
         close(ConnectionNumber(display));
       }
+      ResetSignalMask();
       dup2(fds[1], 1);  /* stdout */
       close(fds[0]);
       close(fds[1]);
@@ -316,7 +316,7 @@ void ShowConfirmDialog(ClientNode *np, void (*action)(ClientNode*), ...)
    dialog->node = AddClientWindow(window, 0, 0);
    Assert(dialog->node);
    if(np) {
-      dialog->node->owner = np->window;
+      SetClientOwner(dialog->node, np->window);
    }
    dialog->node->state.status |= STAT_WMDIALOG;
    FocusClient(dialog->node);
@@ -349,6 +349,7 @@ void DestroyConfirmDialog(void)
    RemoveClient(dialog->node);
 
    /* Free the pixmap. */
+   ReleaseStringContext(dialog->pmap);
    JXFreePixmap(display, dialog->pmap);
 
    /* Free the message. */
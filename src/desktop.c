@@ -21,6 +21,7 @@
 #include "grab.h"
 #include "event.h"
 #include "tray.h"
+#include "spatial.h"
 
 static char **desktopNames = NULL;
 static char *showingDesktop = NULL;
@@ -154,7 +155,8 @@ char BelowDesktop(void)
 void ChangeDesktop(unsigned int desktop)
 {
 
-   ClientNode *np;
+   ClientNode **clients;
+   unsigned int count;
    unsigned int x;
 
    if(JUNLIKELY(desktop >= settings.desktopCount)) {
@@ -165,33 +167,38 @@ void ChangeDesktop(unsigned int desktop)
       return;
    }
 
+   /* Only the clients on the old and new desktops change visibility.
+    * The map and unmap requests are buffered along with the restack
+    * that follows so that they reach the server together.
+    */
+
    /* Hide clients from the old desktop.
     * Note that we show clients in a separate loop to prevent an issue
     * with clients losing focus.
     */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(np = nodes[x]; np; np = np->next) {
-         if(np->state.status & STAT_STICKY) {
-            continue;
-         }
-         if(np->state.desktop == currentDesktop) {
-            HideClient(np);
-            if((np->state.status & STAT_MINIMIZED) && (np->state.status & STAT_ACTIVE)) {
-               np->state.status &= ~STAT_ACTIVE;
-            }
+   clients = GetDesktopClients(currentDesktop, &count);
+   for(x = 0; x < count; x++) {
+      ClientNode *np = clients[x];
+      if(np->state.status & STAT_STICKY) {
+         continue;
+      }
+      if(np->state.desktop == currentDesktop) {
+         HideClient(np);
+         if((np->state.status & STAT_MINIMIZED) && (np->state.status & STAT_ACTIVE)) {
+            np->state.status &= ~STAT_ACTIVE;
          }
       }
    }
 
    /* Show clients on the new desktop. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(np = nodes[x]; np; np = np->next) {
-         if(np->state.status & STAT_STICKY) {
-            continue;
-         }
-         if(np->state.desktop == desktop) {
-            ShowClient(np);
-         }
+   clients = GetDesktopClients(desktop, &count);
+   for(x = 0; x < count; x++) {
+      ClientNode *np = clients[x];
+      if(np->state.status & STAT_STICKY) {
+         continue;
+      }
+      if(np->state.desktop == desktop) {
+         ShowClient(np);
       }
    }
 
@@ -32,26 +32,79 @@
 #include "pager.h"
 #include "grab.h"
 #include "screen.h"
+#include "misc.h"
+#include "error.h"
+#include "spatial.h"
+
+#include <errno.h>
+#include <time.h>
+
+#ifdef USE_EPOLL
+#  include <sys/epoll.h>
+#  include <sys/timerfd.h>
+#  include <sys/signalfd.h>
+#endif
 
 #define MIN_TIME_DELTA 50
 
+/** Maximum number of epoll events to process per wakeup. */
+#define MAX_EPOLL_EVENTS 16
+
 Time eventTime = CurrentTime;
 
+/** Maximum time to sleep when exiting with no events (ms). */
+#define EXIT_SLEEP_TIME RESTART_DELAY
+
 typedef struct CallbackNode {
-   TimeType last;
-   int freq;
+   TimeType next;             /**< Time the callback is due. */
+   int freq;                  /**< Frequency in milliseconds. */
    SignalCallback callback;
    void *data;
-   struct CallbackNode *next;
+   unsigned int index;        /**< Position in the callback heap. */
 } CallbackNode;
 
-static CallbackNode *callbacks = NULL;
+/** Callbacks stored as a binary min-heap ordered by due time. */
+static CallbackNode **callbacks = NULL;
+static unsigned int callbackCount = 0;
+static unsigned int callbackSize = 0;
+
+/** File descriptors watched by the event loop. */
+typedef struct EventFDNode {
+   int fd;
+   EventFDCallback callback;
+   void *data;
+   struct EventFDNode *next;
+} EventFDNode;
+
+static EventFDNode *eventFDs = NULL;
+
+#ifdef USE_EPOLL
+static int epollFD = -1;
+static int timerFD = -1;
+static int signalFD = -1;
+static sigset_t signalMask;
+static TimeType timerTime;
+static char timerArmed = 0;
+#endif
 
 static char restack_pending = 0;
 static char task_update_pending = 0;
 static char pager_update_pending = 0;
+static char client_list_pending = 0;
 
 static void Signal(void);
+static void WaitForInput(void);
+#ifdef USE_EPOLL
+static void UpdateTimer(void);
+static void HandleTimerFD(int fd, void *data);
+static void HandleSignalFD(int fd, void *data);
+#else
+static long GetCallbackDelay(void);
+#endif
+static void PlaceCallback(CallbackNode *cp, unsigned int index);
+static void GetSchedulerTime(TimeType *t);
+static void SiftCallbackUp(unsigned int index);
+static void SiftCallbackDown(unsigned int index);
 
 static void ProcessBinding(MouseContextType context, ClientNode *np,
                            unsigned state, int code, int x, int y);
@@ -93,44 +146,25 @@ static void HandleShapeEvent(const XShapeEvent *event);
 /** Wait for an event and process it. */
 char WaitForEvent(XEvent *event)
 {
-   struct timeval timeout;
-   CallbackNode *cp;
-   fd_set fds;
-   long sleepTime;
-   int fd;
    char handled;
 
-#ifdef ConnectionNumber
-   fd = ConnectionNumber(display);
-#else
-   fd = JXConnectionNumber(display);
-#endif
-
-   /* Compute how long we should sleep. */
-   sleepTime = 10 * 1000;  /* 10 seconds. */
-   for(cp = callbacks; cp; cp = cp->next) {
-      if(cp->freq > 0 && cp->freq < sleepTime) {
-         sleepTime = cp->freq;
-      }
-   }
-
    do {
 
-      while(JXPending(display) == 0) {
-         FD_ZERO(&fds);
-         FD_SET(fd, &fds);
-         timeout.tv_sec = sleepTime / 1000;
-         timeout.tv_usec = (sleepTime % 1000) * 1000;
-         if(select(fd + 1, &fds, NULL, NULL, &timeout) <= 0) {
-            Signal();
+      for(;;) {
+
+         /* Run pending updates and due callbacks before sleeping. */
+         Signal();
+         if(JXPending(display) > 0) {
+            break;
          }
+
+         /* Sleep until the next callback is due or input arrives. */
+         WaitForInput();
          if(JUNLIKELY(shouldExit)) {
             return 0;
          }
       }
 
-      Signal();
-
       JXNextEvent(display, event);
       UpdateTime(event);
 
@@ -239,12 +273,11 @@ char WaitForEvent(XEvent *event)
 /** Wake up components that need to run at certain times. */
 void Signal(void)
 {
-   static TimeType last = ZERO_TIME;
-
-   CallbackNode *cp;   
    TimeType now;
+   TimeType due;
    Window w;
    int x, y;
+   char haveMouse;
 
    if(restack_pending) {
       RestackClients();
@@ -254,26 +287,183 @@ void Signal(void)
       UpdateTaskBar();
       task_update_pending = 0;
    }
+   if(client_list_pending) {
+      UpdateNetClientList();
+      client_list_pending = 0;
+   }
    if(pager_update_pending) {
       UpdatePager();
       pager_update_pending = 0;
    }
 
+   if(callbackCount == 0) {
+      return;
+   }
+
+   /* Dispatch only the callbacks that are due.
+    * Each callback is rescheduled before it runs so that it is free
+    * to register or unregister callbacks (including itself). */
+   GetSchedulerTime(&due);
    GetCurrentTime(&now);
-   if(GetTimeDifference(&now, &last) < MIN_TIME_DELTA) {
+   haveMouse = 0;
+   while(callbackCount > 0 && CompareTime(&callbacks[0]->next, &due) <= 0) {
+      CallbackNode *cp = callbacks[0];
+      cp->next = due;
+      AddTime(&cp->next, Max(cp->freq, MIN_TIME_DELTA));
+      SiftCallbackDown(0);
+      if(!haveMouse) {
+         GetMousePosition(&x, &y, &w);
+         haveMouse = 1;
+      }
+      (cp->callback)(&now, x, y, w, cp->data);
+   }
+}
+
+#ifdef USE_EPOLL
+
+/** Sleep until one of the registered file descriptors is ready. */
+void WaitForInput(void)
+{
+   struct epoll_event events[MAX_EPOLL_EVENTS];
+   int count;
+   int i;
+
+   UpdateTimer();
+   count = epoll_wait(epollFD, events, MAX_EPOLL_EVENTS,
+                      shouldExit ? EXIT_SLEEP_TIME : -1);
+   for(i = 0; i < count; i++) {
+      /* Look up the node by descriptor since an earlier callback
+       * may have unregistered it. */
+      const EventFDNode *np;
+      for(np = eventFDs; np; np = np->next) {
+         if(np->fd == events[i].data.fd) {
+            if(np->callback) {
+               (np->callback)(np->fd, np->data);
+            }
+            break;
+         }
+      }
+   }
+}
+
+/** Arm the timer for the next callback deadline.
+ * The timer is only reprogrammed when the earliest deadline changes,
+ * and it is disarmed entirely when no callbacks are registered.
+ */
+void UpdateTimer(void)
+{
+   struct itimerspec spec;
+   TimeType now;
+
+   if(callbackCount == 0) {
+      if(timerArmed) {
+         memset(&spec, 0, sizeof(spec));
+         timerfd_settime(timerFD, 0, &spec, NULL);
+         timerArmed = 0;
+      }
+      return;
+   }
+   if(timerArmed && CompareTime(&timerTime, &callbacks[0]->next) == 0) {
+      return;
+   }
+
+   timerTime = callbacks[0]->next;
+   timerArmed = 1;
+   memset(&spec, 0, sizeof(spec));
+   GetSchedulerTime(&now);
+   if(CompareTime(&timerTime, &now) > 0) {
+      const unsigned long delay = GetTimeDifference(&timerTime, &now);
+      spec.it_value.tv_sec = delay / 1000;
+      spec.it_value.tv_nsec = (delay % 1000) * 1000000;
+   } else {
+      /* Already due; a zero value would disarm the timer. */
+      spec.it_value.tv_nsec = 1;
+   }
+   timerfd_settime(timerFD, 0, &spec, NULL);
+}
+
+/** Acknowledge a timer expiration. */
+void HandleTimerFD(int fd, void *data)
+{
+   uint64_t expirations;
+   while(read(fd, &expirations, sizeof(expirations)) > 0);
+   timerArmed = 0;
+}
+
+/** Handle signals delivered through the signal file descriptor. */
+void HandleSignalFD(int fd, void *data)
+{
+   struct signalfd_siginfo info;
+   while(read(fd, &info, sizeof(info)) == sizeof(info)) {
+      if(info.ssi_signo == SIGCHLD) {
+         while(waitpid((pid_t)-1, NULL, WNOHANG) > 0);
+      } else {
+         shouldExit = 1;
+      }
+   }
+}
+
+#else /* USE_EPOLL */
+
+/** Sleep until one of the registered file descriptors is ready. */
+void WaitForInput(void)
+{
+   struct timeval timeout;
+   EventFDNode *np;
+   fd_set fds;
+   long sleepTime;
+   int maxfd;
+
+   sleepTime = GetCallbackDelay();
+   if(JUNLIKELY(shouldExit)) {
+      if(sleepTime < 0 || sleepTime > EXIT_SLEEP_TIME) {
+         sleepTime = EXIT_SLEEP_TIME;
+      }
+   }
+
+   FD_ZERO(&fds);
+   maxfd = -1;
+   for(np = eventFDs; np; np = np->next) {
+      FD_SET(np->fd, &fds);
+      maxfd = Max(maxfd, np->fd);
+   }
+
+   if(sleepTime >= 0) {
+      timeout.tv_sec = sleepTime / 1000;
+      timeout.tv_usec = (sleepTime % 1000) * 1000;
+      if(select(maxfd + 1, &fds, NULL, NULL, &timeout) <= 0) {
+         return;
+      }
+   } else if(select(maxfd + 1, &fds, NULL, NULL, NULL) <= 0) {
       return;
    }
-   last = now;
 
-   GetMousePosition(&x, &y, &w);
-   for(cp = callbacks; cp; cp = cp->next) {
-      if(cp->freq == 0 || GetTimeDifference(&now, &cp->last) >= cp->freq) {
-         cp->last = now;
-         (cp->callback)(&now, x, y, w, cp->data);
+   for(np = eventFDs; np; np = np->next) {
+      if(np->callback && FD_ISSET(np->fd, &fds)) {
+         (np->callback)(np->fd, np->data);
+         break;
       }
    }
 }
 
+/** Get the number of milliseconds until the next callback is due.
+ * Returns -1 if there are no callbacks.
+ */
+long GetCallbackDelay(void)
+{
+   TimeType now;
+   if(callbackCount == 0) {
+      return -1;
+   }
+   GetSchedulerTime(&now);
+   if(CompareTime(&callbacks[0]->next, &now) <= 0) {
+      return 0;
+   }
+   return (long)GetTimeDifference(&callbacks[0]->next, &now);
+}
+
+#endif /* USE_EPOLL */
+
 /** Process an event. */
 void ProcessEvent(XEvent *event)
 {
@@ -872,6 +1062,7 @@ void HandleConfigureRequest(const XConfigureRequestEvent *event)
             SendConfigureEvent(np);
          } else {
             JXMoveWindow(display, np->window, np->x, np->y);
+            UpdateClientIndex(np);
          }
       }
 
@@ -1012,7 +1203,7 @@ char HandlePropertyNotify(const XPropertyEvent *event)
          WriteState(np);
          break;
       case XA_WM_TRANSIENT_FOR:
-         JXGetTransientForHint(display, np->window, &np->owner);
+         ReadWMTransientFor(np);
          break;
       case XA_WM_ICON_NAME:
          break;
@@ -1028,6 +1219,7 @@ char HandlePropertyNotify(const XPropertyEvent *event)
             ReadWMProtocols(np->window, &np->state);
          } else if(event->atom == atoms[ATOM_NET_WM_ICON]) {
             LoadIcon(np);
+            ReleaseTitleCache(np);
             changed = 1;
          } else if(event->atom == atoms[ATOM_NET_WM_NAME]) {
             ReadWMName(np);
@@ -1614,6 +1806,7 @@ void HandleMapRequest(const XMapEvent *event)
          }
          if(!(np->state.status & STAT_STICKY)) {
             np->state.desktop = currentDesktop;
+            UpdateClientIndex(np);
          }
          if(!(np->state.status & STAT_NOFOCUS)) {
             FocusClient(np);
@@ -1731,6 +1924,8 @@ void UpdateState(ClientNode *np)
       np->next->prev = np;
    }
    nodes[np->state.layer] = np;
+   UpdateClientIndex(np);
+   InvalidateStackOrder();
 
    if(active) {
       FocusClient(np);
@@ -1781,39 +1976,229 @@ void UpdateTime(const XEvent *event)
    }
 }
 
+/** Prepare the event loop. */
+void StartupEventLoop(void)
+{
+#ifdef USE_EPOLL
+   epollFD = epoll_create1(EPOLL_CLOEXEC);
+   if(JUNLIKELY(epollFD < 0)) {
+      FatalError(_("could not create epoll instance: %s"), strerror(errno));
+   }
+
+   timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+   if(JUNLIKELY(timerFD < 0)) {
+      FatalError(_("could not create timer: %s"), strerror(errno));
+   }
+   timerArmed = 0;
+
+   /* Signals are delivered through the event loop rather than
+    * asynchronous handlers, so they must be blocked. */
+   sigemptyset(&signalMask);
+   sigaddset(&signalMask, SIGTERM);
+   sigaddset(&signalMask, SIGINT);
+   sigaddset(&signalMask, SIGHUP);
+   sigaddset(&signalMask, SIGCHLD);
+   sigprocmask(SIG_BLOCK, &signalMask, NULL);
+   signalFD = signalfd(-1, &signalMask, SFD_NONBLOCK | SFD_CLOEXEC);
+   if(JUNLIKELY(signalFD < 0)) {
+      FatalError(_("could not create signal descriptor: %s"),
+                 strerror(errno));
+   }
+
+   RegisterEventFD(timerFD, HandleTimerFD, NULL);
+   RegisterEventFD(signalFD, HandleSignalFD, NULL);
+#endif
+
+   /* The X connection is read by Xlib; we only need to wake up. */
+#ifdef ConnectionNumber
+   RegisterEventFD(ConnectionNumber(display), NULL, NULL);
+#else
+   RegisterEventFD(JXConnectionNumber(display), NULL, NULL);
+#endif
+}
+
+/** Tear down the event loop. */
+void ShutdownEventLoop(void)
+{
+   while(eventFDs) {
+      UnregisterEventFD(eventFDs->fd);
+   }
+#ifdef USE_EPOLL
+   close(signalFD);
+   close(timerFD);
+   close(epollFD);
+   signalFD = -1;
+   timerFD = -1;
+   epollFD = -1;
+   sigprocmask(SIG_UNBLOCK, &signalMask, NULL);
+#endif
+}
+
+/** Restore the signal mask for a child process. */
+void ResetSignalMask(void)
+{
+#ifdef USE_EPOLL
+   sigprocmask(SIG_UNBLOCK, &signalMask, NULL);
+#endif
+}
+
+/** Register a file descriptor with the event loop. */
+void RegisterEventFD(int fd, EventFDCallback callback, void *data)
+{
+   EventFDNode *np;
+#ifdef USE_EPOLL
+   struct epoll_event event;
+#endif
+
+   np = Allocate(sizeof(EventFDNode));
+   np->fd = fd;
+   np->callback = callback;
+   np->data = data;
+   np->next = eventFDs;
+   eventFDs = np;
+
+#ifdef USE_EPOLL
+   memset(&event, 0, sizeof(event));
+   event.events = EPOLLIN;
+   event.data.fd = fd;
+   if(JUNLIKELY(epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) < 0)) {
+      Warning(_("could not watch file descriptor %d: %s"),
+              fd, strerror(errno));
+   }
+#endif
+}
+
+/** Unregister a file descriptor from the event loop. */
+void UnregisterEventFD(int fd)
+{
+   EventFDNode **np;
+   for(np = &eventFDs; *np; np = &(*np)->next) {
+      if((*np)->fd == fd) {
+         EventFDNode *temp = *np;
+#ifdef USE_EPOLL
+         epoll_ctl(epollFD, EPOLL_CTL_DEL, fd, NULL);
+#endif
+         *np = (*np)->next;
+         Release(temp);
+         return;
+      }
+   }
+   Assert(0);
+}
+
+/** Get the time used to schedule callbacks.
+ * This uses the monotonic clock (as does the timerfd) so that changes
+ * to the system clock don't delay or hurry the callbacks. Callbacks are
+ * still passed the wall-clock time.
+ */
+void GetSchedulerTime(TimeType *t)
+{
+#ifdef CLOCK_MONOTONIC
+   struct timespec ts;
+   if(JLIKELY(clock_gettime(CLOCK_MONOTONIC, &ts) == 0)) {
+      t->seconds = ts.tv_sec;
+      t->ms = ts.tv_nsec / 1000000;
+      return;
+   }
+#endif
+   GetCurrentTime(t);
+}
+
 /** Register a callback. */
 void RegisterCallback(int freq, SignalCallback callback, void *data)
 {
    CallbackNode *cp;
    cp = Allocate(sizeof(CallbackNode));
-   cp->last.seconds = 0;
-   cp->last.ms = 0;
+   cp->next.seconds = 0;
+   cp->next.ms = 0;
    cp->freq = freq;
    cp->callback = callback;
    cp->data = data;
-   cp->next = callbacks;
-   callbacks = cp;
+   if(callbackCount == callbackSize) {
+      callbackSize = callbackSize ? callbackSize * 2 : 16;
+      callbacks = Reallocate(callbacks, callbackSize * sizeof(CallbackNode*));
+   }
+   PlaceCallback(cp, callbackCount);
+   callbackCount += 1;
+   SiftCallbackUp(cp->index);
 }
 
 /** Unregister a callback. */
 void UnregisterCallback(SignalCallback callback, void *data)
 {
-   CallbackNode **cp;
-   for(cp = &callbacks; *cp; cp = &(*cp)->next) {
-      if((*cp)->callback == callback && (*cp)->data == data) {
-         CallbackNode *temp = *cp;
-         *cp = (*cp)->next;
-         Release(temp);
+   unsigned int i;
+   for(i = 0; i < callbackCount; i++) {
+      CallbackNode *cp = callbacks[i];
+      if(cp->callback == callback && cp->data == data) {
+         callbackCount -= 1;
+         if(i < callbackCount) {
+            CallbackNode *last = callbacks[callbackCount];
+            PlaceCallback(last, i);
+            SiftCallbackUp(i);
+            SiftCallbackDown(last->index);
+         }
+         Release(cp);
+         if(callbackCount == 0) {
+            Release(callbacks);
+            callbacks = NULL;
+            callbackSize = 0;
+         }
          return;
       }
    }
    Assert(0);
 }
 
+/** Store a callback at the specified position in the heap. */
+void PlaceCallback(CallbackNode *cp, unsigned int index)
+{
+   callbacks[index] = cp;
+   cp->index = index;
+}
+
+/** Move a callback toward the root of the heap as needed. */
+void SiftCallbackUp(unsigned int index)
+{
+   CallbackNode *cp = callbacks[index];
+   while(index > 0) {
+      const unsigned int parent = (index - 1) / 2;
+      if(CompareTime(&callbacks[parent]->next, &cp->next) <= 0) {
+         break;
+      }
+      PlaceCallback(callbacks[parent], index);
+      index = parent;
+   }
+   PlaceCallback(cp, index);
+}
+
+/** Move a callback toward the leaves of the heap as needed. */
+void SiftCallbackDown(unsigned int index)
+{
+   CallbackNode *cp = callbacks[index];
+   for(;;) {
+      unsigned int child = index * 2 + 1;
+      if(child >= callbackCount) {
+         break;
+      }
+      if(child + 1 < callbackCount
+         && CompareTime(&callbacks[child + 1]->next,
+                        &callbacks[child]->next) < 0) {
+         child += 1;
+      }
+      if(CompareTime(&cp->next, &callbacks[child]->next) <= 0) {
+         break;
+      }
+      PlaceCallback(callbacks[child], index);
+      index = child;
+   }
+   PlaceCallback(cp, index);
+}
+
 /** Restack clients before waiting for an event. */
 void RequireRestack()
 {
    restack_pending = 1;
+   InvalidateStackOrder();
 }
 
 /** Update the task bar before waiting for an event. */
@@ -1827,3 +2212,9 @@ void RequirePagerUpdate()
 {
    pager_update_pending = 1;
 }
+
+/** Update _NET_CLIENT_LIST before waiting for an event. */
+void RequireClientListUpdate()
+{
+   client_list_pending = 1;
+}
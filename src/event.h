@@ -17,9 +17,26 @@ typedef void (*SignalCallback)(const struct TimeType *now,
                                Window w,
                                void *data);
 
+typedef void (*EventFDCallback)(int fd, void *data);
+
 /** Last event time. */
 extern Time eventTime;
 
+/** Prepare the event loop.
+ * This is called once after the X connection is opened.
+ */
+void StartupEventLoop(void);
+
+/** Tear down the event loop.
+ * This is called once before the X connection is closed.
+ */
+void ShutdownEventLoop(void);
+
+/** Restore the signal mask for a child process.
+ * This should be called after fork in the child before exec.
+ */
+void ResetSignalMask(void);
+
 /** Wait for an event and process it.
  * @return 1 if there is an event to process, 0 otherwise.
  */
@@ -63,6 +80,18 @@ void RegisterCallback(int freq, SignalCallback callback, void *data);
  */
 void UnregisterCallback(SignalCallback callback, void *data);
 
+/** Register a file descriptor with the event loop.
+ * @param fd The file descriptor to watch for input.
+ * @param callback The function to call when fd is readable (may be NULL).
+ * @param data Data to pass to the callback.
+ */
+void RegisterEventFD(int fd, EventFDCallback callback, void *data);
+
+/** Unregister a file descriptor from the event loop.
+ * @param fd The file descriptor to remove.
+ */
+void UnregisterEventFD(int fd);
+
 /** Restack clients before waiting for an event. */
 void RequireRestack();
 
@@ -72,5 +101,8 @@ void RequireTaskUpdate();
 /** Update the pager before waiting for an event. */
 void RequirePagerUpdate();
 
+/** Update _NET_CLIENT_LIST before waiting for an event. */
+void RequireClientListUpdate();
+
 #endif /* EVENT_H */
 
@@ -12,6 +12,7 @@
 #include "main.h"
 #include "error.h"
 #include "misc.h"
+#include "settings.h"
 
 #ifdef USE_PANGO
 #  include <pango/pango.h>
@@ -48,8 +49,51 @@ static const struct {
    { FONT_TRAY, FONT_TRAYBUTTON  }
 };
 
+/** Size of the text cache hash table (must be a power of 2). */
+#define TEXT_HASH_SIZE 256
+
+/** Approximate memory used by a laid out string. */
+#define LAYOUT_SIZE           1024
+#define LAYOUT_SIZE_PER_CHAR  64
+
+/** Cached measurement (and layout) of a string. */
+typedef struct TextNode {
+   char *str;                 /**< The string. */
+   char *utf8String;          /**< The string converted to UTF-8. */
+   unsigned int hash;         /**< Hash of the key. */
+   FontType font;             /**< The font. */
+   int maxWidth;              /**< Width limit, -1 for measurements. */
+   int width;                 /**< Width of the string in pixels. */
+   size_t size;               /**< Approximate memory used. */
+#ifdef USE_PANGO
+   PangoLayout *layout;       /**< Layout for rendering (or NULL). */
+#endif
+   struct TextNode *prev;     /**< More recently used entry. */
+   struct TextNode *next;     /**< Less recently used entry. */
+   struct TextNode *hashNext; /**< Next entry in the hash bucket. */
+} TextNode;
+
 static char *GetUTF8String(const char *str);
-static void ReleaseUTF8String(char *utf8String);
+static unsigned int GetTextHash(FontType ft, const char *str, int maxWidth);
+static TextNode *GetTextNode(FontType ft, const char *str, int maxWidth);
+static TextNode *CreateTextNode(FontType ft, const char *str, int maxWidth);
+static void RemoveTextNode(TextNode *tp);
+static void DestroyTextNode(TextNode *tp);
+static void TrimTextCache(size_t limit);
+
+#ifdef USE_PANGO
+/** Maximum number of drawables with a cached XftDraw. */
+#define DRAW_CACHE_SIZE 16
+
+/** A cached XftDraw for a drawable. */
+typedef struct DrawNode {
+   Drawable drawable;
+   XftDraw *xd;
+   struct DrawNode *next;
+} DrawNode;
+
+static XftDraw *GetXftDraw(Drawable d);
+#endif
 
 #ifdef USE_ICONV
 static const char *UTF8_CODESET = "UTF-8";
@@ -68,6 +112,20 @@ static XFontStruct *fonts[FONT_COUNT];
 #endif
 static char *fontNames[FONT_COUNT];
 
+static TextNode *textHash[TEXT_HASH_SIZE];
+static TextNode *textHead = NULL;
+static TextNode *textTail = NULL;
+static TextNode *uncachedText = NULL;  /**< Last result if not caching. */
+static size_t textCacheSize = 0;
+static unsigned int textCacheHits = 0;
+static unsigned int textCacheMisses = 0;
+
+#ifdef USE_PANGO
+static DrawNode *drawCache = NULL;  /**< Most recently used first. */
+#else
+static GC fontGC = NULL;
+#endif
+
 #ifdef USE_PANGO
 static int IsXlfd(const char *str);
 #endif
@@ -189,6 +247,35 @@ void StartupFonts(void)
 void ShutdownFonts(void)
 {
    unsigned int x;
+
+   /* Release the text cache (layouts reference the font context). */
+   Debug("text cache: %u hits, %u misses (%u%% hit rate)",
+         textCacheHits, textCacheMisses,
+         textCacheHits + textCacheMisses > 0
+            ? 100 * textCacheHits / (textCacheHits + textCacheMisses) : 0);
+   TrimTextCache(0);
+   if(uncachedText) {
+      DestroyTextNode(uncachedText);
+      uncachedText = NULL;
+   }
+   textCacheHits = 0;
+   textCacheMisses = 0;
+
+   /* Release draw contexts. */
+#ifdef USE_PANGO
+   while(drawCache) {
+      DrawNode *dp = drawCache->next;
+      JXftDrawDestroy(drawCache->xd);
+      Release(drawCache);
+      drawCache = dp;
+   }
+#else
+   if(fontGC != NULL) {
+      JXFreeGC(display, fontGC);
+      fontGC = NULL;
+   }
+#endif
+
    for(x = 0; x < FONT_COUNT; x++) {
       if(fonts[x]) {
 #ifdef USE_PANGO
@@ -300,42 +387,176 @@ char *GetUTF8String(const char *str)
    return utf8String;
 }
 
-/** Release a UTF-8 string. */
-void ReleaseUTF8String(char *utf8String)
+/** Get the hash of a text cache key. */
+unsigned int GetTextHash(FontType ft, const char *str, int maxWidth)
 {
-#ifdef USE_ICONV
-   if(toUTF8 != (iconv_t)-1) {
-      Release(utf8String);
+   unsigned int hash = (unsigned int)ft * 31 + (unsigned int)maxWidth;
+   unsigned int x;
+   for(x = 0; str[x]; x++) {
+      hash = (hash + (hash << 5)) ^ (unsigned char)str[x];
    }
-#endif
+   return hash;
 }
 
-/** Get the width of a string. */
-int GetStringWidth(FontType ft, const char *str)
+/** Get a text cache entry, creating it if necessary. */
+TextNode *GetTextNode(FontType ft, const char *str, int maxWidth)
 {
-   char *utf8String;
-   int result;
+   unsigned int hash;
+   unsigned int index;
+   TextNode *tp;
+
+   /* The previous result is not needed. */
+   if(uncachedText) {
+      DestroyTextNode(uncachedText);
+      uncachedText = NULL;
+   }
+
+   /* With no cache, keep the result only until the next call. */
+   if(settings.fontCacheSize == 0) {
+      textCacheMisses += 1;
+      uncachedText = CreateTextNode(ft, str, maxWidth);
+      return uncachedText;
+   }
+
+   /* Make room for the new entry. */
+   TrimTextCache((size_t)settings.fontCacheSize * 1024);
 
+   hash = GetTextHash(ft, str, maxWidth);
+   index = hash & (TEXT_HASH_SIZE - 1);
+
+   for(tp = textHash[index]; tp; tp = tp->hashNext) {
+      if(tp->hash == hash && tp->font == ft && tp->maxWidth == maxWidth
+         && !strcmp(tp->str, str)) {
+         break;
+      }
+   }
+
+   if(tp) {
+      textCacheHits += 1;
+      if(tp == textHead) {
+         return tp;
+      }
+      /* Move to the front of the LRU list. */
+      tp->prev->next = tp->next;
+      if(tp->next) {
+         tp->next->prev = tp->prev;
+      } else {
+         textTail = tp->prev;
+      }
+   } else {
+      textCacheMisses += 1;
+      tp = CreateTextNode(ft, str, maxWidth);
+      tp->hash = hash;
+      tp->hashNext = textHash[index];
+      textHash[index] = tp;
+      textCacheSize += tp->size;
+      if(!textTail) {
+         textTail = tp;
+      }
+   }
+
+   tp->prev = NULL;
+   tp->next = textHead;
+   if(textHead) {
+      textHead->prev = tp;
+   }
+   textHead = tp;
+   return tp;
+}
+
+/** Measure (and lay out if needed) a string for the text cache. */
+TextNode *CreateTextNode(FontType ft, const char *str, int maxWidth)
+{
+   TextNode *tp = Allocate(sizeof(TextNode));
+   size_t len;
 #ifdef USE_PANGO
    PangoRectangle rect;
 #endif
 
+   tp->str = CopyString(str);
+   tp->font = ft;
+   tp->maxWidth = maxWidth;
+
    /* Convert to UTF-8 if necessary. */
-   utf8String = GetUTF8String(str);
+   tp->utf8String = GetUTF8String(str);
+   if(tp->utf8String == str) {
+      tp->utf8String = CopyString(str);
+   }
+   len = strlen(tp->utf8String);
 
+   tp->size = sizeof(TextNode) + strlen(str) + len + 2;
 #ifdef USE_PANGO
-   pango_layout_set_text(fonts[ft], utf8String, -1);
-   pango_layout_set_width(fonts[ft], -1);
-   pango_layout_get_extents(fonts[ft], NULL, &rect);
-   result = (rect.width + PANGO_SCALE - 1) / PANGO_SCALE;
+   if(maxWidth >= 0) {
+      /* Keep the layout for rendering so the string is only shaped once.
+       * The width is not needed for these entries. */
+      tp->layout = pango_layout_copy(fonts[ft]);
+      pango_layout_set_text(tp->layout, str, -1);
+      pango_layout_set_width(tp->layout, maxWidth * PANGO_SCALE);
+      tp->width = maxWidth;
+      tp->size += LAYOUT_SIZE + LAYOUT_SIZE_PER_CHAR * len;
+   } else {
+      pango_layout_set_text(fonts[ft], tp->utf8String, -1);
+      pango_layout_set_width(fonts[ft], -1);
+      pango_layout_get_extents(fonts[ft], NULL, &rect);
+      tp->width = (rect.width + PANGO_SCALE - 1) / PANGO_SCALE;
+      tp->layout = NULL;
+   }
 #else
-   result = XTextWidth(fonts[ft], utf8String, strlen(utf8String));
+   tp->width = XTextWidth(fonts[ft], tp->utf8String, len);
 #endif
 
-   /* Clean up. */
-   ReleaseUTF8String(utf8String);
+   return tp;
+}
 
-   return result;
+/** Remove an entry from the text cache. */
+void RemoveTextNode(TextNode *tp)
+{
+   TextNode **pp = &textHash[tp->hash & (TEXT_HASH_SIZE - 1)];
+   while(*pp != tp) {
+      pp = &(*pp)->hashNext;
+   }
+   *pp = tp->hashNext;
+
+   if(tp->prev) {
+      tp->prev->next = tp->next;
+   } else {
+      textHead = tp->next;
+   }
+   if(tp->next) {
+      tp->next->prev = tp->prev;
+   } else {
+      textTail = tp->prev;
+   }
+
+   textCacheSize -= tp->size;
+   DestroyTextNode(tp);
+}
+
+/** Release a text cache entry that is not in the cache. */
+void DestroyTextNode(TextNode *tp)
+{
+#ifdef USE_PANGO
+   if(tp->layout) {
+      g_object_unref(tp->layout);
+   }
+#endif
+   Release(tp->str);
+   Release(tp->utf8String);
+   Release(tp);
+}
+
+/** Remove the least recently used text until the cache fits a limit. */
+void TrimTextCache(size_t limit)
+{
+   while(textTail && textCacheSize > limit) {
+      RemoveTextNode(textTail);
+   }
+}
+
+/** Get the width of a string. */
+int GetStringWidth(FontType ft, const char *str)
+{
+   return GetTextNode(ft, str, -1)->width;
 }
 
 /** Get the height of a string. */
@@ -361,22 +582,71 @@ void SetFont(FontType type, const char *name)
    fontNames[type] = CopyString(name);
 }
 
+#ifdef USE_PANGO
+/** Get an XftDraw for a drawable, creating it if needed. */
+XftDraw *GetXftDraw(Drawable d)
+{
+   DrawNode **prev = &drawCache;
+   DrawNode *dp;
+   unsigned int count = 0;
+
+   /* Look for the drawable, moving it to the front if found. */
+   for(dp = drawCache; dp; dp = dp->next) {
+      count += 1;
+      if(dp->drawable == d) {
+         *prev = dp->next;
+         dp->next = drawCache;
+         drawCache = dp;
+         return dp->xd;
+      }
+      if(dp->next == NULL && count >= DRAW_CACHE_SIZE) {
+         /* Not found and the cache is full; reuse the oldest entry. */
+         *prev = NULL;
+         JXftDrawDestroy(dp->xd);
+         break;
+      }
+      prev = &dp->next;
+   }
+   if(dp == NULL) {
+      dp = Allocate(sizeof(DrawNode));
+   }
+
+   dp->drawable = d;
+   dp->xd = JXftDrawCreate(display, d, rootVisual, rootColormap);
+   dp->next = drawCache;
+   drawCache = dp;
+   return dp->xd;
+}
+#endif
+
+/** Release the context used to render strings to a drawable. */
+void ReleaseStringContext(Drawable d)
+{
+#ifdef USE_PANGO
+   DrawNode **prev = &drawCache;
+   DrawNode *dp;
+   for(dp = drawCache; dp; dp = dp->next) {
+      if(dp->drawable == d) {
+         *prev = dp->next;
+         JXftDrawDestroy(dp->xd);
+         Release(dp);
+         return;
+      }
+      prev = &dp->next;
+   }
+#endif
+}
+
 /** Display a string. */
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str)
 {
    XRectangle rect;
-   Region renderRegion;
-   int len;
-   char *utf8String;
+   const TextNode *tp;
 #ifdef USE_PANGO
    XftDraw *xd;
    PangoLayoutLine *line;
    XftColor *xc;
-#else
-   XGCValues gcValues;
-   unsigned long gcMask;
-   GC gc;
 #endif
 
    /* Early return for empty strings. */
@@ -384,55 +654,49 @@ void RenderString(Drawable d, FontType font, ColorType color,
       return;
    }
 
-   /* Convert to UTF-8 if necessary. */
-   utf8String = GetUTF8String(str);
-   len = strlen(utf8String);
-
    /* Get the bounds for the string based on the specified width. */
    rect.x = x;
    rect.y = y;
    rect.height = GetStringHeight(font);
    rect.width = width + 2;
 
-   /* Combine the width bounds with the region to use. */
-   renderRegion = XCreateRegion();
-   XUnionRectWithRegion(&rect, renderRegion, renderRegion);
-
 #ifdef USE_PANGO
 
-   pango_layout_set_text(fonts[font], str, -1);
-   pango_layout_set_width(fonts[font], width * PANGO_SCALE);
+   /* Get the string laid out for this width. */
+   tp = GetTextNode(font, str, width);
 
-   xd = XftDrawCreate(display, d, rootVisual, rootColormap);
-   JXftDrawSetClip(xd, renderRegion);
+   xd = GetXftDraw(d);
+   JXftDrawSetClipRectangles(xd, 0, 0, &rect, 1);
    xc = GetXftColor(color);
 #  if PANGO_VERSION_CHECK(1, 16, 0)
-   line = pango_layout_get_line_readonly(fonts[font], 0);
+   line = pango_layout_get_line_readonly(tp->layout, 0);
 #  else
-   line = pango_layout_get_line(fonts[font], 0);
+   line = pango_layout_get_line(tp->layout, 0);
 #  endif
    pango_xft_render_layout_line(xd, xc, line, x * PANGO_SCALE,
       y * PANGO_SCALE + font_ascents[font]);
 
-   JXftDrawDestroy(xd);
 #else
 
-   gcMask = GCGraphicsExposures;
-   gcValues.graphics_exposures = False;
-   gc = JXCreateGC(display, d, gcMask, &gcValues);
+   /* Get the string converted to UTF-8. */
+   tp = GetTextNode(font, str, -1);
+
+   /* A GC can be used with any drawable of the same depth,
+    * so one is shared for all strings. */
+   if(fontGC == NULL) {
+      XGCValues gcValues;
+      gcValues.graphics_exposures = False;
+      fontGC = JXCreateGC(display, rootWindow, GCGraphicsExposures,
+                          &gcValues);
+   }
 
    /* Display the string. */
-   JXSetForeground(display, gc, colors[color]);
-   JXSetRegion(display, gc, renderRegion);
-   JXSetFont(display, gc, fonts[font]->fid);
-   JXDrawString(display, d, gc, x, y + fonts[font]->ascent, utf8String, len);
+   JXSetForeground(display, fontGC, colors[color]);
+   JXSetClipRectangles(display, fontGC, 0, 0, &rect, 1, Unsorted);
+   JXSetFont(display, fontGC, fonts[font]->fid);
+   JXDrawString(display, d, fontGC, x, y + fonts[font]->ascent,
+                tp->utf8String, strlen(tp->utf8String));
 
-   JXFreeGC(display, gc);
 #endif
 
-   XDestroyRegion(renderRegion);
-
-   /* Free any memory used for UTF conversion. */
-   ReleaseUTF8String(utf8String);
-
 }
@@ -47,6 +47,12 @@ void SetFont(FontType type, const char *name);
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str);
 
+/** Release the context used to render strings to a drawable.
+ * This must be called before freeing a drawable passed to RenderString.
+ * @param d The drawable.
+ */
+void ReleaseStringContext(Drawable d);
+
 /** Get the width of a string.
  * @param ft The font used to determine the width.
  * @param str The string whose width to get.
@@ -9,13 +9,16 @@
 
 #include "jwm.h"
 #include "main.h"
+#include "timing.h"
 
 static unsigned int grabCount = 0;
+static TimeType grabTime;
 
 /** Grab the server and sync. */
 void GrabServer(void)
 {
    if(grabCount == 0) {
+      GetCurrentTime(&grabTime);
       JXGrabServer(display);
       JXSync(display, False);
    }
@@ -28,7 +31,10 @@ void UngrabServer(void)
    Assert(grabCount > 0);
    grabCount -= 1;
    if(grabCount == 0) {
+      TimeType now;
       JXUngrabServer(display);
+      GetCurrentTime(&now);
+      Debug("server grabbed for %lu ms", GetTimeDifference(&now, &grabTime));
    }
 }
 
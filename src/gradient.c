@@ -5,12 +5,52 @@
  *
  * @brief Gradient fill functions.
  *
+ * Gradients are rendered once into a strip one pixel wide (or high)
+ * and then used as a tile to fill the requested area. The strips are
+ * kept in a small cache so that repainting a gradient is a single
+ * fill request regardless of its size.
+ *
  */
 
 #include "jwm.h"
 #include "gradient.h"
 #include "main.h"
 
+/** Maximum number of gradient strips to keep. */
+#define GRADIENT_CACHE_SIZE 32
+
+/** A rendered gradient strip. */
+typedef struct GradientNode {
+   long fromColor;
+   long toColor;
+   unsigned length;
+   GradientDirection direction;
+   Pixmap strip;
+   struct GradientNode *next;
+} GradientNode;
+
+/** Gradient strips (most recently used first). */
+static GradientNode *gradientCache = NULL;
+static unsigned int gradientCount = 0;
+
+static GradientNode *GetGradientStrip(Drawable d,
+                                      long fromColor, long toColor,
+                                      unsigned length,
+                                      GradientDirection gd);
+static void RenderGradientStrip(GradientNode *gp);
+
+/** Release cached gradients. */
+void ShutdownGradients(void)
+{
+   while(gradientCache) {
+      GradientNode *gp = gradientCache->next;
+      JXFreePixmap(display, gradientCache->strip);
+      Release(gradientCache);
+      gradientCache = gp;
+   }
+   gradientCount = 0;
+}
+
 /** Draw a gradient. */
 void DrawGradient(Drawable d, GC g,
                   long fromColor, long toColor,
@@ -19,22 +59,89 @@ void DrawGradient(Drawable d, GC g,
                   GradientDirection gd)
 {
 
+   const GradientNode *gp;
+   unsigned length;
+
+   /* Return if there's nothing to do or if the background was filled elsewhere. */
+   if((width == 0 || height == 0) || (fromColor == toColor)) {
+      return;
+   }
+
+   /* Fill the area using the gradient strip as a tile. */
+   length = gd == GRADIENT_VERTICAL ? height : width;
+   gp = GetGradientStrip(d, fromColor, toColor, length, gd);
+   JXSetTile(display, g, gp->strip);
+   JXSetTSOrigin(display, g, x, y);
+   JXSetFillStyle(display, g, FillTiled);
+   JXFillRectangle(display, d, g, x, y, width, height);
+   JXSetFillStyle(display, g, FillSolid);
+   JXSetTSOrigin(display, g, 0, 0);
+
+}
+
+/** Get a gradient strip, rendering it if it is not cached. */
+GradientNode *GetGradientStrip(Drawable d,
+                               long fromColor, long toColor,
+                               unsigned length, GradientDirection gd)
+{
+   GradientNode **prev = &gradientCache;
+   GradientNode *gp;
+
+   /* Look for the gradient, moving it to the front if found. */
+   for(gp = gradientCache; gp; gp = gp->next) {
+      if(gp->fromColor == fromColor && gp->toColor == toColor
+         && gp->length == length && gp->direction == gd) {
+         *prev = gp->next;
+         gp->next = gradientCache;
+         gradientCache = gp;
+         return gp;
+      }
+      if(gp->next == NULL && gradientCount >= GRADIENT_CACHE_SIZE) {
+         /* Not found and the cache is full; reuse the oldest entry. */
+         *prev = NULL;
+         JXFreePixmap(display, gp->strip);
+         gradientCount -= 1;
+         break;
+      }
+      prev = &gp->next;
+   }
+   if(gp == NULL) {
+      gp = Allocate(sizeof(GradientNode));
+   }
+
+   gp->fromColor = fromColor;
+   gp->toColor = toColor;
+   gp->length = length;
+   gp->direction = gd;
+   if(gd == GRADIENT_VERTICAL) {
+      gp->strip = JXCreatePixmap(display, d, 1, length, rootDepth);
+   } else {
+      gp->strip = JXCreatePixmap(display, d, length, 1, rootDepth);
+   }
+   RenderGradientStrip(gp);
+
+   gp->next = gradientCache;
+   gradientCache = gp;
+   gradientCount += 1;
+   return gp;
+}
+
+/** Render a gradient strip. */
+void RenderGradientStrip(GradientNode *gp)
+{
+
+   XImage *image;
    unsigned i;
-   unsigned limit;
    XColor colors[2];
    float red, green, blue;
    float ared, agreen, ablue;
    float bred, bgreen, bblue;
    float redStep, greenStep, blueStep;
-
-   /* Return if there's nothing to do or if the background was filled elsewhere. */
-   if((width == 0 || height == 0) || (fromColor == toColor)) {
-      return;
-   }
+   unsigned width, height;
 
    /* Query the from/to colors. */
-   colors[0].pixel = fromColor;
-   colors[1].pixel = toColor;
+   colors[0].pixel = gp->fromColor;
+   colors[1].pixel = gp->toColor;
    JXQueryColors(display, rootColormap, colors, 2);
 
    /* Set the "from" color. */
@@ -48,41 +155,50 @@ void DrawGradient(Drawable d, GC g,
    bblue = colors[1].blue;
 
    /* Determine the step. */
-   if(gd == GRADIENT_VERTICAL) {
-      redStep = (bred - ared) / height;
-      greenStep = (bgreen - agreen) / height;
-      blueStep = (bblue - ablue) / height;
-      limit = height;
+   redStep = (bred - ared) / gp->length;
+   greenStep = (bgreen - agreen) / gp->length;
+   blueStep = (bblue - ablue) / gp->length;
+
+   /* Create a temporary XImage for the strip. */
+   if(gp->direction == GRADIENT_VERTICAL) {
+      width = 1;
+      height = gp->length;
    } else {
-      redStep = (bred - ared) / width;
-      greenStep = (bgreen - agreen) / width;
-      blueStep = (bblue - ablue) / width;
-      limit = width;
+      width = gp->length;
+      height = 1;
    }
+   image = JXCreateImage(display, rootVisual, rootDepth,
+                         ZPixmap, 0, NULL, width, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
 
-   /* Loop over each line or column. */
+   /* Loop over each pixel of the strip. */
    red = ared;
    blue = ablue;
    green = agreen;
-   for(i = 0; i < limit; i++) {
+   for(i = 0; i < gp->length; i++) {
 
-      /* Determine the color for this line. */
+      /* Determine the color for this pixel. */
       colors[0].red = (unsigned short)red;
       colors[0].green = (unsigned short)green;
       colors[0].blue = (unsigned short)blue;
 
       GetColor(&colors[0]);
 
-      /* Draw the line. */
-      JXSetForeground(display, g, colors[0].pixel);
-      if(gd == GRADIENT_VERTICAL) {
-         JXDrawLine(display, d, g, x, y + i, x + width - 1, y + i);
+      if(gp->direction == GRADIENT_VERTICAL) {
+         XPutPixel(image, 0, i, colors[0].pixel);
       } else {
-         JXDrawLine(display, d, g, x + i, y, x + i + 1, y + height - 1);
+         XPutPixel(image, i, 0, colors[0].pixel);
       }
-      
+
       red += redStep;
       green += greenStep;
       blue += blueStep;
    }
+
+   /* Upload the strip. */
+   JXPutImage(display, gp->strip, rootGC, image, 0, 0, 0, 0, width, height);
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
+
 }
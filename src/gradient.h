@@ -12,8 +12,18 @@
 
 #include "color.h"
 
+/*@{*/
+#define InitializeGradients()    (void)(0)
+#define StartupGradients()       (void)(0)
+void ShutdownGradients(void);
+#define DestroyGradients()       (void)(0)
+/*@}*/
+
 /** Draw a gradient.
  * Note that no action is taken if fromColor == toColor.
+ * The gradient is drawn by tiling a cached strip, which changes the tile
+ * and fill style of the graphics context. The fill style is restored to
+ * FillSolid.
  * @param d The drawable on which to draw the gradient.
  * @param g The graphics context to use.
  * @param fromColor The starting color pixel value.
@@ -28,6 +28,10 @@ typedef unsigned int MatchType;
 typedef struct PatternListType {
    char *pattern;
    MatchType match;
+   regex_t re;                   /**< Compiled pattern (if compiled). */
+   char compiled;                /**< Set if the pattern was compiled. */
+   char *literal;                /**< The only string matched (or NULL). */
+   int windowType;               /**< Window type for MATCH_TYPE. */
    struct PatternListType *next;
 } PatternListType;
 
@@ -46,16 +50,224 @@ typedef struct OptionListType {
 typedef struct GroupType {
    PatternListType *patterns;
    OptionListType *options;
+   unsigned int order;           /**< Position in the group list. */
    struct GroupType *next;
 } GroupType;
 
+/** Entry in a group index.
+ * Entries in each bucket are sorted by group order.
+ */
+typedef struct GroupIndexNode {
+   const char *key;              /**< The literal to match (or NULL). */
+   GroupType *group;
+   struct GroupIndexNode *next;
+} GroupIndexNode;
+
+/* Must be a power of two. */
+#define GROUP_HASH_SIZE 256
+
+static const StringMappingType windowTypeMapping[] = {
+   { "desktop",      WINDOW_TYPE_DESKTOP      },
+   { "dialog",       WINDOW_TYPE_DIALOG       },
+   { "dock",         WINDOW_TYPE_DOCK         },
+   { "menu",         WINDOW_TYPE_MENU         },
+   { "normal",       WINDOW_TYPE_NORMAL       },
+   { "notification", WINDOW_TYPE_NOTIFICATION },
+   { "splash",       WINDOW_TYPE_SPLASH       },
+   { "toolbar",      WINDOW_TYPE_TOOLBAR      },
+   { "utility",      WINDOW_TYPE_UTILITY      }
+};
+
 static GroupType *groups = NULL;
 
+/* Groups are indexed by literal class, literal name, or window type.
+ * Groups that cannot be indexed are kept in otherGroups. */
+static GroupIndexNode *classIndex[GROUP_HASH_SIZE];
+static GroupIndexNode *nameIndex[GROUP_HASH_SIZE];
+static GroupIndexNode *typeIndex[WINDOW_TYPE_COUNT];
+static GroupIndexNode *otherGroups;
+
 static void ReleasePatternList(PatternListType *lp);
 static void ReleaseOptionList(OptionListType *lp);
 static void AddPattern(PatternListType **lp, const char *pattern,
                        MatchType match);
 static void ApplyGroup(const GroupType *gp, ClientNode *np);
+static char MatchesGroup(const GroupType *gp, const ClientNode *np);
+static char *GetLiteral(const char *pattern);
+static unsigned int GetGroupHash(const char *str);
+static char IsLiteralMatch(const GroupType *gp, MatchType match);
+static void AddIndex(GroupIndexNode **bucket, const char *key, GroupType *gp);
+static void ReleaseIndex(GroupIndexNode **bucket);
+static GroupIndexNode *NextIndex(GroupIndexNode *ip, const char *key);
+
+/** Build the group index. */
+void StartupGroups(void)
+{
+   GroupType *gp;
+   PatternListType *lp;
+   unsigned int order;
+
+   memset(classIndex, 0, sizeof(classIndex));
+   memset(nameIndex, 0, sizeof(nameIndex));
+   memset(typeIndex, 0, sizeof(typeIndex));
+   otherGroups = NULL;
+
+   /* Groups are indexed by the first kind of pattern that narrows
+    * the set of windows they can apply to.  Since every kind of pattern
+    * present must match, a group is only a candidate for windows found
+    * through that index. */
+   order = 0;
+   for(gp = groups; gp; gp = gp->next) {
+      gp->order = order++;
+      if(IsLiteralMatch(gp, MATCH_CLASS)) {
+         for(lp = gp->patterns; lp; lp = lp->next) {
+            if(lp->match == MATCH_CLASS) {
+               AddIndex(&classIndex[GetGroupHash(lp->literal)],
+                        lp->literal, gp);
+            }
+         }
+      } else if(IsLiteralMatch(gp, MATCH_NAME)) {
+         for(lp = gp->patterns; lp; lp = lp->next) {
+            if(lp->match == MATCH_NAME) {
+               AddIndex(&nameIndex[GetGroupHash(lp->literal)],
+                        lp->literal, gp);
+            }
+         }
+      } else if(IsLiteralMatch(gp, MATCH_TYPE)) {
+         for(lp = gp->patterns; lp; lp = lp->next) {
+            if(lp->match == MATCH_TYPE && lp->windowType >= 0) {
+               AddIndex(&typeIndex[lp->windowType], NULL, gp);
+            }
+         }
+      } else {
+         AddIndex(&otherGroups, NULL, gp);
+      }
+   }
+}
+
+/** Release the group index. */
+void ShutdownGroups(void)
+{
+   unsigned int x;
+   for(x = 0; x < GROUP_HASH_SIZE; x++) {
+      ReleaseIndex(&classIndex[x]);
+      ReleaseIndex(&nameIndex[x]);
+   }
+   for(x = 0; x < WINDOW_TYPE_COUNT; x++) {
+      ReleaseIndex(&typeIndex[x]);
+   }
+   ReleaseIndex(&otherGroups);
+}
+
+/** Determine if a group can be indexed by a kind of pattern.
+ * This requires at least one pattern of that kind, each of which
+ * matches a single value.
+ */
+char IsLiteralMatch(const GroupType *gp, MatchType match)
+{
+   const PatternListType *lp;
+   char found = 0;
+   for(lp = gp->patterns; lp; lp = lp->next) {
+      if(lp->match == match) {
+         if(match != MATCH_TYPE && !lp->literal) {
+            return 0;
+         }
+         found = 1;
+      }
+   }
+   return found;
+}
+
+/** Append a group to an index bucket. */
+void AddIndex(GroupIndexNode **bucket, const char *key, GroupType *gp)
+{
+   GroupIndexNode *ip;
+
+   /* Groups are added in order, so we only need to check the end
+    * of the bucket for a duplicate. */
+   while(*bucket) {
+      ip = *bucket;
+      if(!ip->next && ip->group == gp
+         && (key == NULL || !strcmp(ip->key, key))) {
+         return;
+      }
+      bucket = &ip->next;
+   }
+
+   ip = Allocate(sizeof(GroupIndexNode));
+   ip->key = key;
+   ip->group = gp;
+   ip->next = NULL;
+   *bucket = ip;
+}
+
+/** Release an index bucket. */
+void ReleaseIndex(GroupIndexNode **bucket)
+{
+   while(*bucket) {
+      GroupIndexNode *next = (*bucket)->next;
+      Release(*bucket);
+      *bucket = next;
+   }
+}
+
+/** Get the next index entry with the specified key. */
+GroupIndexNode *NextIndex(GroupIndexNode *ip, const char *key)
+{
+   while(ip && ip->key && strcmp(ip->key, key)) {
+      ip = ip->next;
+   }
+   return ip;
+}
+
+/** Get the hash for a string. */
+unsigned int GetGroupHash(const char *str)
+{
+   unsigned int hash = 0;
+   unsigned int x;
+   for(x = 0; str[x]; x++) {
+      hash = (hash + (hash << 5)) ^ (unsigned int)str[x];
+   }
+   return hash & (GROUP_HASH_SIZE - 1);
+}
+
+/** Get the string matched by a pattern if it matches only one string.
+ * This is the case for patterns of the form "^literal$".
+ * Returns NULL if the pattern can match more than one string.
+ */
+char *GetLiteral(const char *pattern)
+{
+   static const char special[] = ".[]()*+?{}|^$\\";
+   const unsigned int len = strlen(pattern);
+   unsigned int i, j;
+   char *result;
+
+   if(len < 2 || pattern[0] != '^' || pattern[len - 1] != '$') {
+      return NULL;
+   }
+
+   result = Allocate(len - 1);
+   j = 0;
+   for(i = 1; i < len - 1; i++) {
+      char ch = pattern[i];
+      if(ch == '\\') {
+         /* Only escaped special characters are literal.
+          * Note that an escaped '$' at the end is not an anchor. */
+         i += 1;
+         ch = pattern[i];
+         if(i == len - 1 || !strchr(special, ch)) {
+            Release(result);
+            return NULL;
+         }
+      } else if(strchr(special, ch)) {
+         Release(result);
+         return NULL;
+      }
+      result[j++] = ch;
+   }
+   result[j] = 0;
+   return result;
+}
 
 /** Destroy group data. */
 void DestroyGroups(void)
@@ -76,6 +288,12 @@ void ReleasePatternList(PatternListType *lp)
    PatternListType *tp;
    while(lp) {
       tp = lp->next;
+      if(lp->compiled) {
+         regfree(&lp->re);
+      }
+      if(lp->literal) {
+         Release(lp->literal);
+      }
       Release(lp->pattern);
       Release(lp);
       lp = tp;
@@ -174,6 +392,22 @@ void AddPattern(PatternListType **lp, const char *pattern, MatchType match)
    *lp = tp;
    tp->pattern = CopyString(pattern);
    tp->match = match;
+
+   tp->literal = NULL;
+   tp->windowType = -1;
+
+   /* Compile the pattern now so that bad patterns are reported while
+    * parsing.  Invalid patterns never match. */
+   if(match == MATCH_TYPE) {
+      tp->compiled = 0;
+      tp->windowType = FindValue(windowTypeMapping,
+                                 ARRAY_LENGTH(windowTypeMapping), pattern);
+   } else {
+      tp->compiled = CompilePattern(&tp->re, pattern);
+      if(tp->compiled) {
+         tp->literal = GetLiteral(pattern);
+      }
+   }
 }
 
 /** Add an option to a group. */
@@ -231,8 +465,59 @@ void AddGroupOptionSigned(GroupType *gp, OptionType option,
 /** Apply groups to a client. */
 void ApplyGroups(ClientNode *np)
 {
-   PatternListType *lp;
-   GroupType *gp;
+   GroupIndexNode *lists[4];
+   unsigned int count;
+   unsigned int x;
+
+   Assert(np);
+
+   /* Get the index buckets that could contain matching groups. */
+   count = 0;
+   if(np->className) {
+      lists[count] = NextIndex(classIndex[GetGroupHash(np->className)],
+                               np->className);
+      count += 1;
+   }
+   if(np->instanceName) {
+      lists[count] = NextIndex(nameIndex[GetGroupHash(np->instanceName)],
+                               np->instanceName);
+      count += 1;
+   }
+   if(np->state.windowType < WINDOW_TYPE_COUNT) {
+      lists[count] = typeIndex[np->state.windowType];
+      count += 1;
+   }
+   lists[count] = otherGroups;
+   count += 1;
+
+   /* Merge the buckets to apply the groups in order. */
+   for(;;) {
+      GroupIndexNode **best = NULL;
+      for(x = 0; x < count; x++) {
+         if(lists[x] && (!best
+            || lists[x]->group->order < (*best)->group->order)) {
+            best = &lists[x];
+         }
+      }
+      if(!best) {
+         break;
+      }
+      if(MatchesGroup((*best)->group, np)) {
+         ApplyGroup((*best)->group, np);
+      }
+      if((*best)->key) {
+         *best = NextIndex((*best)->next, (*best)->key);
+      } else {
+         *best = (*best)->next;
+      }
+   }
+
+}
+
+/** Determine if a client matches the patterns of a group. */
+char MatchesGroup(const GroupType *gp, const ClientNode *np)
+{
+   const PatternListType *lp;
    char hasClass;
    char hasName;
    char hasTitle;
@@ -244,70 +529,51 @@ void ApplyGroups(ClientNode *np)
    char matchesType;
    char matchesClient;
 
-   static const StringMappingType windowTypeMapping[] = {
-      { "desktop",      WINDOW_TYPE_DESKTOP      },
-      { "dialog",       WINDOW_TYPE_DIALOG       },
-      { "dock",         WINDOW_TYPE_DOCK         },
-      { "menu",         WINDOW_TYPE_MENU         },
-      { "normal",       WINDOW_TYPE_NORMAL       },
-      { "notification", WINDOW_TYPE_NOTIFICATION },
-      { "splash",       WINDOW_TYPE_SPLASH       },
-      { "toolbar",      WINDOW_TYPE_TOOLBAR      },
-      { "utility",      WINDOW_TYPE_UTILITY      }
-   };
-
-   Assert(np);
-   for(gp = groups; gp; gp = gp->next) {
-      hasClass = 0;
-      hasName = 0;
-      hasType = 0;
-      hasTitle = 0;
-      hasClient = 0;
-      matchesClass = 0;
-      matchesName = 0;
-      matchesTitle = 0;
-      matchesType = 0;
-      matchesClient = 0;
-      for(lp = gp->patterns; lp; lp = lp->next) {
-         if(lp->match == MATCH_CLASS) {
-            if(Match(lp->pattern, np->className)) {
-               matchesClass = 1;
-            }
-            hasClass = 1;
-         } else if(lp->match == MATCH_NAME) {
-            if(Match(lp->pattern, np->instanceName)) {
-               matchesName = 1;
-            }
-            hasName = 1;
-         } else if(lp->match == MATCH_TITLE) {
-            if(Match(lp->pattern, np->name)) {
-               matchesTitle = 1;
-            }
-            hasTitle = 1;
-         } else if(lp->match == MATCH_TYPE) {
-             if(FindValue(windowTypeMapping, WINDOW_TYPE_COUNT, lp->pattern)
-             == np->state.windowType) {
-                matchesType = 1;
-             }
-             hasType = 1;
-         } else if(lp->match == MATCH_MACHINE) {
-            if(Match(lp->pattern, np->clientName)) {
-               matchesClient = 1;
-            }
-             hasClient = 1;
-         } else {
-            Debug("invalid match in ApplyGroups: %d", lp->match);
+   hasClass = 0;
+   hasName = 0;
+   hasType = 0;
+   hasTitle = 0;
+   hasClient = 0;
+   matchesClass = 0;
+   matchesName = 0;
+   matchesTitle = 0;
+   matchesType = 0;
+   matchesClient = 0;
+   for(lp = gp->patterns; lp; lp = lp->next) {
+      if(lp->match == MATCH_CLASS) {
+         if(lp->compiled && MatchPattern(&lp->re, np->className)) {
+            matchesClass = 1;
          }
-      }
-      if(hasName == matchesName
-      && hasClass == matchesClass
-      && hasTitle == matchesTitle
-      && hasType == matchesType
-      && hasClient == matchesClient) {
-         ApplyGroup(gp, np);
+         hasClass = 1;
+      } else if(lp->match == MATCH_NAME) {
+         if(lp->compiled && MatchPattern(&lp->re, np->instanceName)) {
+            matchesName = 1;
+         }
+         hasName = 1;
+      } else if(lp->match == MATCH_TITLE) {
+         if(lp->compiled && MatchPattern(&lp->re, np->name)) {
+            matchesTitle = 1;
+         }
+         hasTitle = 1;
+      } else if(lp->match == MATCH_TYPE) {
+         if(lp->windowType == np->state.windowType) {
+            matchesType = 1;
+         }
+         hasType = 1;
+      } else if(lp->match == MATCH_MACHINE) {
+         if(lp->compiled && MatchPattern(&lp->re, np->clientName)) {
+            matchesClient = 1;
+         }
+         hasClient = 1;
+      } else {
+         Debug("invalid match in ApplyGroups: %d", lp->match);
       }
    }
-
+   return hasName == matchesName
+       && hasClass == matchesClass
+       && hasTitle == matchesTitle
+       && hasType == matchesType
+       && hasClient == matchesClient;
 }
 
 /** Apply a group to a client. */
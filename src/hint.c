@@ -14,6 +14,8 @@
 #include "misc.h"
 #include "font.h"
 #include "settings.h"
+#include "icon.h"
+#include "spatial.h"
 
 #include <X11/Xlibint.h>
 
@@ -45,6 +47,14 @@
 
 #define MWM_TEAROFF_WINDOW (1L << 0)
 
+/* Sizes of the ICCCM properties (in 32-bit units). */
+#define WM_HINTS_SIZE          9
+#define WM_SIZE_HINTS_SIZE     18
+#define WM_OLD_SIZE_HINTS_SIZE 15
+
+/* Maximum length of the text properties we read (in 32-bit units). */
+#define MAX_TEXT_LENGTH 1024
+
 typedef struct {
 
    unsigned long flags;
@@ -189,6 +199,7 @@ void StartupHints(void)
    char *data;
    Atom *supported;
    Window win;
+   char **names;
    unsigned int x;
    unsigned int count;
 
@@ -207,10 +218,16 @@ void StartupHints(void)
    array = (unsigned long*)data;
    supported = (Atom*)data;
 
-   /* Intern the atoms */
+   /* Intern the atoms (in a single request). */
+   names = AllocateStack(ATOM_COUNT * sizeof(char*));
+   for(x = 0; x < ATOM_COUNT; x++) {
+      names[x] = (char*)atomList[x].name;
+   }
+   JXInternAtoms(display, names, ATOM_COUNT, False, supported);
    for(x = 0; x < ATOM_COUNT; x++) {
-      *atomList[x].atom = JXInternAtom(display, atomList[x].name, False);
+      *atomList[x].atom = supported[x];
    }
+   ReleaseStack(names);
 
    /* _NET_SUPPORTED */
    for(x = FIRST_NET_ATOM; x <= LAST_NET_ATOM; x++) {
@@ -282,13 +299,73 @@ void ReadCurrentDesktop(void)
    }
 }
 
+/** Determine the desktop ReadCurrentDesktop will switch to. */
+unsigned int GetInitialDesktop(void)
+{
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   unsigned int desktop;
+   Atom atom;
+   int status;
+
+   /* The atoms have not been interned yet. */
+   atom = JXInternAtom(display, "_NET_CURRENT_DESKTOP", True);
+   if(atom == None) {
+      return 0;
+   }
+
+   desktop = 0;
+   status = JXGetWindowProperty(display, rootWindow, atom, 0, 1, False,
+                                XA_CARDINAL, &realType, &realFormat,
+                                &count, &extra, &data);
+   if(status == Success && realFormat != 0 && data) {
+      if(count == 1 && *(unsigned long*)data < settings.desktopCount) {
+         desktop = *(unsigned long*)data;
+      }
+      JXFree(data);
+   }
+   return desktop;
+}
+
+/** Request the properties read when a client is added.
+ * With XCB, all of the requests are sent at once and the replies are
+ * collected as ReadClientInfo and friends read the properties.
+ */
+void PrefetchClientInfo(Window win)
+{
+   PrefetchProperty(win, atoms[ATOM_NET_WM_NAME], MAX_TEXT_LENGTH);
+   PrefetchProperty(win, XA_WM_NAME, MAX_TEXT_LENGTH);
+   PrefetchProperty(win, XA_WM_CLASS, MAX_TEXT_LENGTH);
+   PrefetchProperty(win, XA_WM_CLIENT_MACHINE, MAX_TEXT_LENGTH);
+   PrefetchProperty(win, XA_WM_NORMAL_HINTS, WM_SIZE_HINTS_SIZE);
+   PrefetchProperty(win, XA_WM_HINTS, WM_HINTS_SIZE);
+   PrefetchProperty(win, XA_WM_TRANSIENT_FOR, 1);
+   PrefetchProperty(win, atoms[ATOM_WM_COLORMAP_WINDOWS], colormapCount);
+   PrefetchProperty(win, atoms[ATOM_WM_PROTOCOLS], 32);
+   PrefetchProperty(win, atoms[ATOM_WM_STATE], 2);
+   PrefetchProperty(win, atoms[ATOM_MOTIF_WM_HINTS], 20);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_WINDOW_OPACITY], 1);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_DESKTOP], 1);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_STATE], 32);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_WINDOW_TYPE], 32);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_USER_TIME_WINDOW], 1);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_USER_TIME], 1);
+#ifdef USE_ICONS
+   PrefetchProperty(win, atoms[ATOM_NET_WM_ICON], ICON_CHUNK_LENGTH);
+#endif
+   PrefetchProperty(win, atoms[ATOM_NET_WM_STRUT_PARTIAL], 12);
+   PrefetchProperty(win, atoms[ATOM_NET_WM_STRUT], 4);
+}
+
 /** Read client hints.
  * This is called while the client is being added to management.
  */
 void ReadClientInfo(ClientNode *np, char alreadyMapped)
 {
 
-   Status status;
    ClientNode *pp;
 
    Assert(np);
@@ -298,11 +375,7 @@ void ReadClientInfo(ClientNode *np, char alreadyMapped)
    ReadWMNormalHints(np);
    ReadWMColormaps(np);
    ReadWMMachine(np);
-
-   status = JXGetTransientForHint(display, np->window, &np->owner);
-   if(!status) {
-      np->owner = None;
-   }
+   ReadWMTransientFor(np);
 
    /* Read the window state. */
    np->state = ReadWindowState(np->window, alreadyMapped);
@@ -353,6 +426,7 @@ void WriteState(ClientNode *np)
    WriteNetState(np);
    WriteFrameExtents(np->window, &np->state);
    WriteNetAllowed(np);
+   UpdateClientIndex(np);
 }
 
 /** Set the opacity of a client. */
@@ -738,7 +812,8 @@ void ReadWMName(ClientNode *np)
    }
 
    status = JXGetWindowProperty(display, np->window,
-                                atoms[ATOM_NET_WM_NAME], 0, 1024, False,
+                                atoms[ATOM_NET_WM_NAME], 0, MAX_TEXT_LENGTH,
+                                False,
                                 atoms[ATOM_UTF8_STRING], &realType,
                                 &realFormat, &count, &extra, &name);
    if(status != Success || realFormat == 0) {
@@ -754,7 +829,7 @@ void ReadWMName(ClientNode *np)
 #ifdef USE_XUTF8
    if(!np->name) {
       status = JXGetWindowProperty(display, np->window,
-                                   XA_WM_NAME, 0, 1024, False,
+                                   XA_WM_NAME, 0, MAX_TEXT_LENGTH, False,
                                    atoms[ATOM_COMPOUND_TEXT],
                                    &realType, &realFormat, &count,
                                    &extra, &name);
@@ -779,12 +854,18 @@ void ReadWMName(ClientNode *np)
 #endif
 
    if(!np->name) {
-      char *temp = NULL;
-      if(JXFetchName(display, np->window, &temp)) {
-         const size_t len = strlen(temp) + 1;
-         np->name = Allocate(len);
-         memcpy(np->name, temp, len);
-         JXFree(temp);
+      status = JXGetWindowProperty(display, np->window,
+                                   XA_WM_NAME, 0, MAX_TEXT_LENGTH, False,
+                                   XA_STRING, &realType, &realFormat,
+                                   &count, &extra, &name);
+      if(status == Success && realType == XA_STRING
+         && realFormat == 8 && name) {
+         np->name = Allocate(count + 1);
+         memcpy(np->name, name, count);
+         np->name[count] = 0;
+      }
+      if(status == Success && name) {
+         JXFree(name);
       }
    }
 
@@ -794,34 +875,93 @@ void ReadWMName(ClientNode *np)
 void ReadWMMachine(ClientNode *np)
 {
    XTextProperty tprop;
+   unsigned long extra;
    char **tlist;
    int tcount;
+   int status;
 
    if(np->clientName) {
       Release(np->clientName);
    }
+   np->clientName = NULL;
 
-   XGetWMClientMachine(display, np->window, &tprop);
+   status = JXGetWindowProperty(display, np->window, XA_WM_CLIENT_MACHINE,
+                                0, MAX_TEXT_LENGTH, False, AnyPropertyType,
+                                &tprop.encoding, &tprop.format,
+                                &tprop.nitems, &extra, &tprop.value);
+   if(status != Success || tprop.encoding == None) {
+      return;
+   }
    if(XmbTextPropertyToTextList(display, &tprop, &tlist, &tcount)
       == Success && tcount > 0) {
       const size_t len = strlen(tlist[0]) + 1;
       np->clientName = Allocate(len);
       memcpy(np->clientName, tlist[0], len);
       XFreeStringList(tlist);
-   } else {
-      np->clientName = NULL;
+   }
+   if(tprop.value) {
+      JXFree(tprop.value);
    }
 }
 
 /** Read the window class for a client. */
 void ReadWMClass(ClientNode *np)
 {
-   XClassHint hint;
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
+   size_t len;
+
    Assert(np);
-   if(JXGetClassHint(display, np->window, &hint)) {
-      np->instanceName = hint.res_name;
-      np->className = hint.res_class;
+
+   status = JXGetWindowProperty(display, np->window, XA_WM_CLASS,
+                                0, MAX_TEXT_LENGTH, False, XA_STRING,
+                                &realType, &realFormat, &count, &extra,
+                                &data);
+   if(status != Success || !data) {
+      return;
+   }
+   if(realType == XA_STRING && realFormat == 8) {
+
+      /* The property contains the instance and class separated by NUL. */
+      len = strlen((char*)data);
+      np->instanceName = CopyString((char*)data);
+      if(len == count) {
+         len -= 1;
+      }
+      np->className = CopyString((char*)&data[len + 1]);
+
    }
+   JXFree(data);
+}
+
+/** Read the transient owner for a client. */
+void ReadWMTransientFor(ClientNode *np)
+{
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
+   Window owner;
+
+   Assert(np);
+
+   owner = None;
+   status = JXGetWindowProperty(display, np->window, XA_WM_TRANSIENT_FOR,
+                                0, 1, False, XA_WINDOW, &realType,
+                                &realFormat, &count, &extra, &data);
+   if(status == Success && data) {
+      if(realFormat == 32 && count > 0) {
+         owner = *(Window*)data;
+      }
+      JXFree(data);
+   }
+   SetClientOwner(np, owner);
 }
 
 /** Read the protocols hint for a window. */
@@ -865,14 +1005,49 @@ void ReadWMNormalHints(ClientNode *np)
 {
 
    XSizeHints hints;
-   long temp;
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
 
    Assert(np);
 
-   if(!JXGetWMNormalHints(display, np->window, &hints, &temp)) {
-      np->sizeFlags = 0;
-   } else {
-      np->sizeFlags = hints.flags;
+   memset(&hints, 0, sizeof(hints));
+   np->sizeFlags = 0;
+   status = JXGetWindowProperty(display, np->window, XA_WM_NORMAL_HINTS,
+                                0, WM_SIZE_HINTS_SIZE, False,
+                                XA_WM_SIZE_HINTS, &realType, &realFormat,
+                                &count, &extra, &data);
+   if(status == Success && data) {
+      if(realType == XA_WM_SIZE_HINTS && realFormat == 32
+         && count >= WM_OLD_SIZE_HINTS_SIZE) {
+
+         /* Decode the hints the same way XGetWMNormalHints does. */
+         const long *prop = (const long*)data;
+         long supplied = USPosition | USSize | PAllHints;
+         hints.flags          = prop[0];
+         hints.min_width      = prop[5];
+         hints.min_height     = prop[6];
+         hints.max_width      = prop[7];
+         hints.max_height     = prop[8];
+         hints.width_inc      = prop[9];
+         hints.height_inc     = prop[10];
+         hints.min_aspect.x   = prop[11];
+         hints.min_aspect.y   = prop[12];
+         hints.max_aspect.x   = prop[13];
+         hints.max_aspect.y   = prop[14];
+         if(count >= WM_SIZE_HINTS_SIZE) {
+            hints.base_width  = prop[15];
+            hints.base_height = prop[16];
+            hints.win_gravity = prop[17];
+            supplied |= PBaseSize | PWinGravity;
+         }
+         np->sizeFlags = hints.flags & supplied;
+
+      }
+      JXFree(data);
    }
 
    if(np->sizeFlags & PResizeInc) {
@@ -935,15 +1110,27 @@ void ReadWMNormalHints(ClientNode *np)
 void ReadWMColormaps(ClientNode *np)
 {
 
-   Window *windows;
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
    ColormapNode *cp;
-   int count;
 
    Assert(np);
 
-   if(JXGetWMColormapWindows(display, np->window, &windows, &count)) {
-      if(count > 0) {
-         int x;
+   /* Keep track of at most colormapCount colormaps for each
+    * window to avoid doing extra work. */
+   status = JXGetWindowProperty(display, np->window,
+                                atoms[ATOM_WM_COLORMAP_WINDOWS],
+                                0, colormapCount, False, XA_WINDOW,
+                                &realType, &realFormat, &count, &extra,
+                                &data);
+   if(status == Success && data) {
+      if(realFormat == 32 && count > 0) {
+         const Window *windows = (const Window*)data;
+         unsigned long x;
 
          /* Free old colormaps. */
          while(np->colormaps) {
@@ -954,10 +1141,7 @@ void ReadWMColormaps(ClientNode *np)
 
          /* Put the maps in the list in order so they will come out in
           * reverse order. This way they will be installed with the
-          * most important last.
-          * Keep track of at most colormapCount colormaps for each
-          * window to avoid doing extra work. */
-         count = Min(colormapCount, count);
+          * most important last. */
          for(x = 0; x < count; x++) {
             cp = Allocate(sizeof(ColormapNode));
             cp->window = windows[x];
@@ -965,9 +1149,8 @@ void ReadWMColormaps(ClientNode *np)
             np->colormaps = cp;
          }
 
-         JXFree(windows);
-
       }
+      JXFree(data);
    }
 
 }
@@ -1010,14 +1193,14 @@ void ReadWMState(Window win, ClientState *state)
 void ReadWMHints(Window win, ClientState *state, char alreadyMapped)
 {
 
-   XWMHints *wmhints;
+   XWMHints hints;
+   XWMHints *wmhints = &hints;
 
    Assert(win != None);
    Assert(state);
 
    state->status |= STAT_CANFOCUS;
-   wmhints = JXGetWMHints(display, win);
-   if(wmhints) {
+   if(GetWMHints(win, wmhints)) {
       if(!alreadyMapped && (wmhints->flags & StateHint)) {
          switch(wmhints->initial_state) {
          case IconicState:
@@ -1035,11 +1218,60 @@ void ReadWMHints(Window win, ClientState *state, char alreadyMapped)
       } else {
          state->status &= ~(STAT_URGENT | STAT_FLASH);
       }
-      JXFree(wmhints);
    }
 
 }
 
+/** Read the WM_HINTS property for a window. */
+char GetWMHints(Window win, XWMHints *hints)
+{
+
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
+   char ret;
+
+   Assert(win != None);
+   Assert(hints);
+
+   status = JXGetWindowProperty(display, win, XA_WM_HINTS,
+                                0, WM_HINTS_SIZE, False, XA_WM_HINTS,
+                                &realType, &realFormat, &count, &extra,
+                                &data);
+   if(status != Success || !data) {
+      return 0;
+   }
+
+   ret = 0;
+   if(realType == XA_WM_HINTS && realFormat == 32
+      && count >= WM_HINTS_SIZE - 1) {
+
+      /* Decode the hints the same way XGetWMHints does. */
+      const long *prop = (const long*)data;
+      hints->flags         = prop[0];
+      hints->input         = prop[1] ? True : False;
+      hints->initial_state = (int)prop[2];
+      hints->icon_pixmap   = prop[3];
+      hints->icon_window   = prop[4];
+      hints->icon_x        = (int)prop[5];
+      hints->icon_y        = (int)prop[6];
+      hints->icon_mask     = prop[7];
+      if(count >= WM_HINTS_SIZE) {
+         hints->window_group = prop[8];
+      } else {
+         hints->window_group = None;
+      }
+      ret = 1;
+
+   }
+   JXFree(data);
+   return ret;
+
+}
+
 /** Read _NET_WM_WINDOW_OPACITY. */
 void ReadWMOpacity(Window win, unsigned *opacity)
 {
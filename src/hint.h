@@ -182,6 +182,17 @@ void StartupHints(void);
 /** Determine the current desktop. */
 void ReadCurrentDesktop(void);
 
+/** Determine the desktop ReadCurrentDesktop will switch to.
+ * This may be called before StartupHints.
+ * @return The initial desktop.
+ */
+unsigned int GetInitialDesktop(void);
+
+/** Request the properties read when a client is added.
+ * @param win The client window.
+ */
+void PrefetchClientInfo(Window win);
+
 /** Read client info.
  * @param np The client.
  * @param alreadyMapped Set if the client is already mapped.
@@ -203,6 +214,11 @@ void ReadWMMachine(struct ClientNode *np);
  */
 void ReadWMClass(struct ClientNode *np);
 
+/** Read the transient owner of a client.
+ * @param np The client.
+ */
+void ReadWMTransientFor(struct ClientNode *np);
+
 /** Read normal hints for a client.
  * @param np The client.
  */
@@ -238,6 +254,13 @@ ClientState ReadWindowState(Window win, char alreadyMapped);
  */
 void ReadWMHints(Window win, ClientState *state, char alreadyMapped);
 
+/** Read the WM_HINTS property for a window.
+ * @param win The window.
+ * @param hints The hints to fill.
+ * @return 1 if the hints were read, 0 otherwise.
+ */
+char GetWMHints(Window win, XWMHints *hints);
+
 /** Read opacity.
  * @param win The window.
  * @param opacity The opacity to update.
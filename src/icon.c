@@ -18,6 +18,13 @@
 #include "color.h"
 #include "settings.h"
 #include "border.h"
+#include "upload.h"
+#include "taskbar.h"
+#include "menu.h"
+#include "timing.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
 
 IconNode emptyIcon;
 
@@ -26,12 +33,33 @@ IconNode emptyIcon;
 /* Must be a power of two. */
 #define HASH_SIZE 128
 
+/* Must be a power of two. */
+#define FILE_HASH_SIZE 1024
+
+/** Minimum time between checking an icon path for changes. */
+#define PATH_CHECK_MS 1000
+
+/** File in an icon path. */
+typedef struct IconFileNode {
+   char *name;
+   struct IconFileNode *next;
+} IconFileNode;
+
 /** Linked list of icon paths. */
 typedef struct IconPathNode {
    char *path;
+   IconFileNode **files;   /**< Files in the path, NULL if not scanned. */
+   time_t mtime;           /**< Modification time when scanned. */
+   TimeType checked;       /**< Last time the modification time was read. */
    struct IconPathNode *next;
 } IconPathNode;
 
+/** Icon name that was not found. */
+typedef struct IconMissNode {
+   char *name;
+   struct IconMissNode *next;
+} IconMissNode;
+
 /* These extensions are appended to icon names during search. */
 const char *ICON_EXTENSIONS[] = {
    "",
@@ -62,21 +90,42 @@ static const unsigned EXTENSION_COUNT = ARRAY_LENGTH(ICON_EXTENSIONS);
 static const unsigned MAX_EXTENSION_LENGTH = 5;
 
 static IconNode **iconHash;
+static IconNode **sharedIcons;
 static IconPathNode *iconPaths;
 static IconPathNode *iconPathsTail;
+static IconMissNode **iconMisses;
 static GC iconGC;
 static char iconSizeSet = 0;
 static char *defaultIconName;
 
-static void DoDestroyIcon(int index, IconNode *icon);
+static void DoDestroyIcon(IconNode **bucket, IconNode *icon);
+static IconNode *ReadClientIcon(const ClientNode *np);
 static IconNode *ReadNetWMIcon(Window win);
+static unsigned long *ReadNetWMIconData(Window win, long offset, long length,
+                                        unsigned long *count,
+                                        unsigned long *extra);
+static char IsBetterIconSize(unsigned long size, unsigned long best,
+                             unsigned long desired);
+static IconNode *GetSharedIcon(const unsigned long *input,
+                               unsigned int length);
+static unsigned int GetBinaryHash(const unsigned long *input,
+                                  unsigned int length);
+static char IsSameIcon(const IconNode *icon, const unsigned long *input,
+                       unsigned int length);
+static unsigned long GetIconPixmapSize(const IconNode *icon);
 static IconNode *ReadWMHintIcon(Window win);
 static IconNode *CreateIcon(const ImageNode *image);
 static IconNode *CreateIconFromDrawable(Drawable d, Pixmap mask);
 static IconNode *CreateIconFromBinary(const unsigned long *data,
                                       unsigned int length);
-static IconNode *LoadNamedIconHelper(const char *name, const char *path,
-                                     char save, char preserveAspect);
+static IconNode *DoLoadNamedIcon(const char *name, char save,
+                                 char preserveAspect, int width, int height);
+static IconNode *LoadNamedIconHelper(const char *name,
+                                     const IconPathNode *ip,
+                                     char save, char preserveAspect,
+                                     int width, int height);
+static IconNode *CreateNamedIcon(ImageNode *image, const char *name,
+                                 char save, char preserveAspect);
 
 static ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight);
 static ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
@@ -84,8 +133,18 @@ static ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
 
 static void InsertIcon(IconNode *icon);
 static IconNode *FindIcon(const char *name);
+static unsigned int GetStringHash(const char *str);
 static unsigned int GetHash(const char *str);
 
+static void UpdateIconPath(IconPathNode *ip);
+static void ScanIconPath(IconPathNode *ip);
+static void ReleaseIconFiles(IconPathNode *ip);
+static char HasIconFile(const IconPathNode *ip, const char *name);
+static char IsIconMiss(const char *name);
+static void AddIconMiss(const char *name);
+static void ClearIconMisses(void);
+static char *FindIconFile(const char *name);
+
 /** Initialize icon data.
  * This must be initialized before parsing the configuration.
  */
@@ -95,8 +154,12 @@ void InitializeIcons(void)
    iconPaths = NULL;
    iconPathsTail = NULL;
    iconHash = Allocate(sizeof(IconNode*) * HASH_SIZE);
+   iconMisses = Allocate(sizeof(IconMissNode*) * HASH_SIZE);
+   sharedIcons = Allocate(sizeof(IconNode*) * HASH_SIZE);
    for(x = 0; x < HASH_SIZE; x++) {
       iconHash[x] = NULL;
+      iconMisses[x] = NULL;
+      sharedIcons[x] = NULL;
    }
    memset(&emptyIcon, 0, sizeof(emptyIcon));
    iconSizeSet = 0;
@@ -125,10 +188,28 @@ void StartupIcons(void)
 /** Shutdown icon support. */
 void ShutdownIcons(void)
 {
+   unsigned long pixmapSize = 0;
+   unsigned int iconCount = 0;
+   unsigned int refCount = 0;
    unsigned int x;
+
+   for(x = 0; x < HASH_SIZE; x++) {
+      const IconNode *icon;
+      for(icon = sharedIcons[x]; icon; icon = icon->next) {
+         pixmapSize += GetIconPixmapSize(icon);
+         iconCount += 1;
+         refCount += icon->refs;
+      }
+   }
+   Debug("window icons: %u unique, %u references, %lu bytes of pixmaps",
+         iconCount, refCount, pixmapSize);
+
    for(x = 0; x < HASH_SIZE; x++) {
       while(iconHash[x]) {
-         DoDestroyIcon(x, iconHash[x]);
+         DoDestroyIcon(&iconHash[x], iconHash[x]);
+      }
+      while(sharedIcons[x]) {
+         DoDestroyIcon(&sharedIcons[x], sharedIcons[x]);
       }
    }
    JXFreeGC(display, iconGC);
@@ -140,6 +221,7 @@ void DestroyIcons(void)
    IconPathNode *pn;
    while(iconPaths) {
       pn = iconPaths->next;
+      ReleaseIconFiles(iconPaths);
       Release(iconPaths->path);
       Release(iconPaths);
       iconPaths = pn;
@@ -149,6 +231,15 @@ void DestroyIcons(void)
       Release(iconHash);
       iconHash = NULL;
    }
+   if(iconMisses) {
+      ClearIconMisses();
+      Release(iconMisses);
+      iconMisses = NULL;
+   }
+   if(sharedIcons) {
+      Release(sharedIcons);
+      sharedIcons = NULL;
+   }
    if(defaultIconName) {
       Release(defaultIconName);
       defaultIconName = NULL;
@@ -184,6 +275,7 @@ void AddIconPath(char *path)
       ip->path[length + 1] = 0;
    }
    ExpandPath(&ip->path);
+   ip->files = NULL;
    ip->next = NULL;
 
    if(iconPathsTail) {
@@ -250,45 +342,65 @@ void PutIcon(IconNode *icon, Drawable d, long fg,
 /** Load the icon for a client. */
 void LoadIcon(ClientNode *np)
 {
-   /* If client already has an icon, destroy it first. */
-   DestroyIcon(np->icon);
-   np->icon = NULL;
+   /* Read the new icon before releasing the old one so that the
+    * scaled copies of a shared icon are kept if the data is unchanged. */
+   IconNode *oldIcon = np->icon;
+   np->icon = ReadClientIcon(np);
+   DestroyIcon(oldIcon);
+}
+
+/** Read the icon for a client. */
+IconNode *ReadClientIcon(const ClientNode *np)
+{
+   IconNode *icon;
 
    /* Attempt to read _NET_WM_ICON for an icon. */
-   np->icon = ReadNetWMIcon(np->window);
-   if(np->icon) {
-      return;
+   icon = ReadNetWMIcon(np->window);
+   if(icon) {
+      return icon;
    }
    if(np->owner != None) {
-      np->icon = ReadNetWMIcon(np->owner);
-      if(np->icon) {
-         return;
+      icon = ReadNetWMIcon(np->owner);
+      if(icon) {
+         return icon;
       }
    }
 
    /* Attempt to read an icon from XWMHints. */
-   np->icon = ReadWMHintIcon(np->window);
-   if(np->icon) {
-      return;
+   icon = ReadWMHintIcon(np->window);
+   if(icon) {
+      return icon;
    }
    if(np->owner != None) {
-      np->icon = ReadNetWMIcon(np->owner);
-      if(np->icon) {
-         return;
+      icon = ReadNetWMIcon(np->owner);
+      if(icon) {
+         return icon;
       }
    }
 
    /* Attempt to read an icon based on the window name. */
    if(np->instanceName) {
-      np->icon = LoadNamedIcon(np->instanceName, 1, 1);
-      if(np->icon) {
-         return;
-      }
+      return LoadNamedIcon(np->instanceName, 1, 1);
    }
+   return NULL;
 }
 
 /** Load an icon from a file. */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
+{
+   return DoLoadNamedIcon(name, save, preserveAspect, 0, 0);
+}
+
+/** Load an icon from a file for display at a known size. */
+IconNode *LoadSizedIcon(const char *name, int width, int height,
+                        char preserveAspect)
+{
+   return DoLoadNamedIcon(name, 0, preserveAspect, width, height);
+}
+
+/** Load an icon from a file, decoding it for the specified size. */
+IconNode *DoLoadNamedIcon(const char *name, char save, char preserveAspect,
+                          int width, int height)
 {
 
    IconNode *icon;
@@ -309,16 +421,9 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
 
    /* Check for an absolute file name. */
    if(name[0] == '/') {
-      ImageNode *image = LoadImage(name, 0, 0, 1);
+      ImageNode *image = LoadImage(name, width, height, preserveAspect);
       if(image) {
-         icon = CreateIcon(image);
-         icon->preserveAspect = preserveAspect;
-         icon->name = CopyString(name);
-         if(save) {
-            InsertIcon(icon);
-         }
-         DestroyImage(image);
-         return icon;
+         return CreateNamedIcon(image, name, save, preserveAspect);
       } else {
          return &emptyIcon;
       }
@@ -326,103 +431,569 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
 
    /* Try icon paths. */
    for(ip = iconPaths; ip; ip = ip->next) {
-      icon = LoadNamedIconHelper(name, ip->path, save, preserveAspect);
+      UpdateIconPath(ip);
+   }
+   if(IsIconMiss(name)) {
+      return NULL;
+   }
+   for(ip = iconPaths; ip; ip = ip->next) {
+      icon = LoadNamedIconHelper(name, ip, save, preserveAspect,
+                                 width, height);
       if(icon) {
          return icon;
       }
    }
 
    /* The default icon. */
+   AddIconMiss(name);
+   return NULL;
+}
+
+/** Request that a named icon be decoded ahead of time. */
+void PreloadNamedIcon(const char *name)
+{
+   PreloadSizedIcon(name, 0, 0, 1);
+}
+
+/** Request that an icon for LoadSizedIcon be decoded ahead of time. */
+void PreloadSizedIcon(const char *name, int width, int height,
+                      char preserveAspect)
+{
+   char *path;
+   if(!name || name[0] == 0 || FindIcon(name)) {
+      return;
+   }
+   path = FindIconFile(name);
+   if(path) {
+      PreloadImage(path, width, height, preserveAspect);
+      Release(path);
+   }
+}
+
+/** Discard an icon requested with PreloadSizedIcon. */
+void CancelPreloadedIcon(const char *name, int width, int height,
+                         char preserveAspect)
+{
+   char *path;
+   if(!name || name[0] == 0) {
+      return;
+   }
+   path = FindIconFile(name);
+   if(path) {
+      CancelPreloadedImage(path, width, height, preserveAspect);
+      Release(path);
+   }
+}
+
+/** Find the file LoadNamedIcon will use for an icon.
+ * The result must be released (NULL if not found).
+ */
+char *FindIconFile(const char *name)
+{
+   IconPathNode *ip;
+   char *temp;
+   unsigned nameLength;
+   unsigned i;
+
+   if(name[0] == '/') {
+      return CopyString(name);
+   }
+
+   nameLength = strlen(name);
+   for(ip = iconPaths; ip; ip = ip->next) {
+      const unsigned pathLength = strlen(ip->path);
+      UpdateIconPath(ip);
+      temp = Allocate(nameLength + pathLength + MAX_EXTENSION_LENGTH + 1);
+      memcpy(&temp[0], ip->path, pathLength);
+      memcpy(&temp[pathLength], name, nameLength + 1);
+      for(i = 0; i < EXTENSION_COUNT; i++) {
+         const unsigned len = strlen(ICON_EXTENSIONS[i]);
+         memcpy(&temp[pathLength + nameLength], ICON_EXTENSIONS[i], len + 1);
+         if(HasIconFile(ip, &temp[pathLength])
+            && access(temp, R_OK) == 0) {
+            return temp;
+         }
+      }
+      Release(temp);
+   }
    return NULL;
 }
 
 /** Helper for loading icons by name. */
-IconNode *LoadNamedIconHelper(const char *name, const char *path,
-                              char save, char preserveAspect)
+IconNode *LoadNamedIconHelper(const char *name, const IconPathNode *ip,
+                              char save, char preserveAspect,
+                              int width, int height)
 {
    ImageNode *image;
+   IconNode *result;
    char *temp;
    const unsigned nameLength = strlen(name);
-   const unsigned pathLength = strlen(path);
+   const unsigned pathLength = strlen(ip->path);
    const char hasExtension = strchr(name, '.') != NULL;
    unsigned i;
 
    /* Full file name. */
    temp = AllocateStack(nameLength + pathLength + MAX_EXTENSION_LENGTH + 1);
-   memcpy(&temp[0], path, pathLength);
+   memcpy(&temp[0], ip->path, pathLength);
    memcpy(&temp[pathLength], name, nameLength + 1);
 
    /* Attempt to load the image. */
    image = NULL;
-   if(hasExtension) {
-      image = LoadImage(temp, 0, 0, 1);
+   result = NULL;
+   if(hasExtension && HasIconFile(ip, &temp[pathLength])) {
+      result = save ? FindIcon(temp) : NULL;
+      if(!result) {
+         image = LoadImage(temp, width, height, preserveAspect);
+      }
    }
-   if(!image) {
+   if(!image && !result) {
       for(i = 0; i < EXTENSION_COUNT; i++) {
          const unsigned len = strlen(ICON_EXTENSIONS[i]);
          memcpy(&temp[pathLength + nameLength], ICON_EXTENSIONS[i], len + 1);
-         image = LoadImage(temp, 0, 0, 1);
+         if(!HasIconFile(ip, &temp[pathLength])) {
+            continue;
+         }
+         result = save ? FindIcon(temp) : NULL;
+         if(result) {
+            break;
+         }
+         image = LoadImage(temp, width, height, preserveAspect);
          if(image) {
             break;
          }
       }
    }
-   ReleaseStack(temp);
 
    /* Create the icon if we were able to load the image. */
    if(image) {
-      IconNode *result = CreateIcon(image);
-      result->preserveAspect = preserveAspect;
-      result->name = CopyString(temp);
-      if(save) {
-         InsertIcon(result);
-      }
+      result = CreateNamedIcon(image, temp, save, preserveAspect);
+   }
+   ReleaseStack(temp);
+
+   return result;
+}
+
+/** Create an icon for an image loaded from a file.
+ * Saved icons are shared by everything that uses the name, so only the
+ * size is kept and the image is decoded again for each size it is drawn
+ * at. Other icons keep the image since it was decoded for its use.
+ */
+IconNode *CreateNamedIcon(ImageNode *image, const char *name,
+                          char save, char preserveAspect)
+{
+   IconNode *icon = CreateIcon(image);
+   icon->preserveAspect = preserveAspect;
+   icon->name = CopyString(name);
+   if(save) {
+      InsertIcon(icon);
       DestroyImage(image);
-      return result;
+   } else {
+      icon->images = image;
    }
+   return icon;
+}
 
-   return NULL;
+/** Make sure the file index for an icon path is current.
+ * The modification time of the directory is checked at most once
+ * every PATH_CHECK_MS so that bursts of lookups don't touch the
+ * file system.
+ */
+void UpdateIconPath(IconPathNode *ip)
+{
+   struct stat st;
+   TimeType now;
+
+   GetCurrentTime(&now);
+   if(ip->files && GetTimeDifference(&now, &ip->checked) < PATH_CHECK_MS) {
+      return;
+   }
+   ip->checked = now;
+
+   if(stat(ip->path, &st) != 0) {
+      st.st_mtime = 0;
+   }
+   if(ip->files && st.st_mtime == ip->mtime) {
+      return;
+   }
+
+   ScanIconPath(ip);
+
+   /* Files added later in the same second don't change the time,
+    * so check again if the directory was modified just now. */
+   ip->mtime = (unsigned long)st.st_mtime >= now.seconds ? 0 : st.st_mtime;
+   ClearIconMisses();
 }
 
-/** Read the icon property from a client. */
-IconNode *ReadNetWMIcon(Window win)
+/** Read the files in an icon path. */
+void ScanIconPath(IconPathNode *ip)
+{
+   struct dirent *entry;
+   DIR *dir;
+   unsigned int count = 0;
+
+   ReleaseIconFiles(ip);
+   ip->files = Allocate(sizeof(IconFileNode*) * FILE_HASH_SIZE);
+   memset(ip->files, 0, sizeof(IconFileNode*) * FILE_HASH_SIZE);
+
+   dir = opendir(ip->path);
+   if(!dir) {
+      return;
+   }
+   while((entry = readdir(dir)) != NULL) {
+      IconFileNode *fp;
+      unsigned int index;
+      if(entry->d_name[0] == '.') {
+         continue;
+      }
+#ifdef DT_DIR
+      if(entry->d_type == DT_DIR) {
+         continue;
+      }
+#endif
+      index = GetStringHash(entry->d_name) & (FILE_HASH_SIZE - 1);
+      fp = Allocate(sizeof(IconFileNode));
+      fp->name = CopyString(entry->d_name);
+      fp->next = ip->files[index];
+      ip->files[index] = fp;
+      count += 1;
+   }
+   closedir(dir);
+   Debug("indexed %u files in %s", count, ip->path);
+}
+
+/** Release the file index for an icon path. */
+void ReleaseIconFiles(IconPathNode *ip)
+{
+   unsigned int x;
+   if(!ip->files) {
+      return;
+   }
+   for(x = 0; x < FILE_HASH_SIZE; x++) {
+      while(ip->files[x]) {
+         IconFileNode *fp = ip->files[x]->next;
+         Release(ip->files[x]->name);
+         Release(ip->files[x]);
+         ip->files[x] = fp;
+      }
+   }
+   Release(ip->files);
+   ip->files = NULL;
+}
+
+/** Determine if a file may exist in an icon path.
+ * Names in subdirectories are not indexed and are assumed to exist.
+ */
+char HasIconFile(const IconPathNode *ip, const char *name)
+{
+   const IconFileNode *fp;
+   if(!ip->files || strchr(name, '/')) {
+      return 1;
+   }
+   fp = ip->files[GetStringHash(name) & (FILE_HASH_SIZE - 1)];
+   while(fp) {
+      if(!strcmp(fp->name, name)) {
+         return 1;
+      }
+      fp = fp->next;
+   }
+   return 0;
+}
+
+/** Determine if an icon name is known not to exist. */
+char IsIconMiss(const char *name)
+{
+   const IconMissNode *mp = iconMisses[GetHash(name)];
+   while(mp) {
+      if(!strcmp(mp->name, name)) {
+         return 1;
+      }
+      mp = mp->next;
+   }
+   return 0;
+}
+
+/** Remember that an icon name was not found.
+ * Names in subdirectories are not remembered since changes to
+ * subdirectories are not detected.
+ */
+void AddIconMiss(const char *name)
+{
+   if(!strchr(name, '/')) {
+      const unsigned int index = GetHash(name);
+      IconMissNode *mp = Allocate(sizeof(IconMissNode));
+      mp->name = CopyString(name);
+      mp->next = iconMisses[index];
+      iconMisses[index] = mp;
+   }
+}
+
+/** Forget icon names that were not found. */
+void ClearIconMisses(void)
+{
+   unsigned int x;
+   for(x = 0; x < HASH_SIZE; x++) {
+      while(iconMisses[x]) {
+         IconMissNode *mp = iconMisses[x]->next;
+         Release(iconMisses[x]->name);
+         Release(iconMisses[x]);
+         iconMisses[x] = mp;
+      }
+   }
+}
+
+/** Read part of the icon property from a client.
+ * @return The data (to be freed with JXFree) or NULL.
+ */
+unsigned long *ReadNetWMIconData(Window win, long offset, long length,
+                                 unsigned long *count, unsigned long *extra)
 {
-   static const long MAX_LENGTH = 1 << 20;
-   IconNode *icon = NULL;
-   unsigned long count;
-   int status;
-   unsigned long extra;
    Atom realType;
    int realFormat;
    unsigned char *data;
+   int status;
    status = JXGetWindowProperty(display, win, atoms[ATOM_NET_WM_ICON],
-                                0, MAX_LENGTH, False, XA_CARDINAL,
-                                &realType, &realFormat, &count, &extra, &data);
-   if(status == Success && realFormat != 0 && data) {
-      icon = CreateIconFromBinary((unsigned long*)data, count);
+                                offset, length, False, XA_CARDINAL,
+                                &realType, &realFormat, count, extra, &data);
+   if(status != Success || !data) {
+      return NULL;
+   }
+   if(realFormat != 32) {
       JXFree(data);
+      return NULL;
    }
+   return (unsigned long*)data;
+}
+
+/** Determine if an image size is closer to the desired size.
+ * The smallest image at least as large as the desired size is best,
+ * otherwise the largest image.
+ */
+char IsBetterIconSize(unsigned long size, unsigned long best,
+                      unsigned long desired)
+{
+   if(size >= desired) {
+      return best < desired || size < best;
+   } else {
+      return best < desired && size > best;
+   }
+}
+
+/** Read the icon property from a client.
+ * Only the image closest to the largest size we draw is read.
+ */
+IconNode *ReadNetWMIcon(Window win)
+{
+   IconNode *icon;
+   unsigned long *data;
+   unsigned long count, extra, total;
+   unsigned long offset;
+   unsigned long bestOffset = 0;
+   unsigned long bestPixels = 0;
+   unsigned long bestSize = 0;
+   unsigned long desired;
+
+   data = ReadNetWMIconData(win, 0, ICON_CHUNK_LENGTH, &count, &extra);
+   if(!data) {
+      return NULL;
+   }
+   total = Min(count + extra / 4, MAX_ICON_PROPERTY_LENGTH);
+   desired = Max(GetBorderIconSize(), GetTaskBarIconSize());
+   desired = Max(desired, GetMenuIconSize());
+
+   /* Walk the image headers, reading those past the first chunk. */
+   offset = 0;
+   while(offset + 2 <= total) {
+      unsigned long width, height;
+      if(offset + 2 <= count) {
+         width = data[offset + 0] & 0xFFFFFFFF;
+         height = data[offset + 1] & 0xFFFFFFFF;
+      } else {
+         unsigned long temp;
+         unsigned long *header = ReadNetWMIconData(win, offset, 2,
+                                                   &temp, &extra);
+         if(!header) {
+            break;
+         }
+         width = temp == 2 ? header[0] & 0xFFFFFFFF : 0;
+         height = temp == 2 ? header[1] & 0xFFFFFFFF : 0;
+         JXFree(header);
+      }
+      if(JUNLIKELY(width == 0 || height == 0
+                   || height > (total - offset - 2) / width)) {
+         Debug("invalid image size: %lu x %lu", width, height);
+         break;
+      }
+      if(bestPixels == 0
+         || IsBetterIconSize(Max(width, height), bestSize, desired)) {
+         bestOffset = offset;
+         bestPixels = width * height;
+         bestSize = Max(width, height);
+      }
+      offset += 2 + width * height;
+   }
+   if(bestPixels == 0) {
+      JXFree(data);
+      return NULL;
+   }
+
+   /* Read the image unless it was in the first chunk. */
+   if(bestOffset + 2 + bestPixels > count) {
+      JXFree(data);
+      data = ReadNetWMIconData(win, bestOffset, 2 + bestPixels,
+                               &count, &extra);
+      if(!data) {
+         return NULL;
+      }
+      bestOffset = 0;
+      if(count < 2 + bestPixels) {
+         JXFree(data);
+         return NULL;
+      }
+   }
+
+   icon = GetSharedIcon(&data[bestOffset], 2 + bestPixels);
+   JXFree(data);
    return icon;
 }
 
+/** Get the icon for binary icon data.
+ * Icons with the same data are shared between clients.
+ */
+IconNode *GetSharedIcon(const unsigned long *input, unsigned int length)
+{
+   const unsigned int hash = GetBinaryHash(input, length);
+   const unsigned int index = hash & (HASH_SIZE - 1);
+   IconNode *icon;
+   for(icon = sharedIcons[index]; icon; icon = icon->next) {
+      if(icon->hash == hash && IsSameIcon(icon, input, length)) {
+         icon->refs += 1;
+         return icon;
+      }
+   }
+   icon = CreateIconFromBinary(input, length);
+   if(icon) {
+      icon->hash = hash;
+      icon->refs = 1;
+      icon->next = sharedIcons[index];
+      if(sharedIcons[index]) {
+         sharedIcons[index]->prev = icon;
+      }
+      sharedIcons[index] = icon;
+   }
+   return icon;
+}
+
+/** Get the hash of icon data. */
+unsigned int GetBinaryHash(const unsigned long *input, unsigned int length)
+{
+   unsigned int hash = 2166136261u;
+   unsigned int x;
+   for(x = 0; x < length; x++) {
+      hash = (hash ^ (unsigned int)(input[x] & 0xFFFFFFFF)) * 16777619u;
+   }
+   return hash;
+}
+
+/** Determine if an icon was created from the specified data.
+ * This walks the data the same way as CreateIconFromBinary.
+ */
+char IsSameIcon(const IconNode *icon, const unsigned long *input,
+                unsigned int length)
+{
+   const ImageNode *image;
+   unsigned int imageCount = 0;
+   unsigned int matched = 0;
+   unsigned int offset = 0;
+
+   for(image = icon->images; image; image = image->next) {
+      imageCount += 1;
+   }
+
+   while(offset < length) {
+      const unsigned width = input[offset + 0];
+      const unsigned height = input[offset + 1];
+      const unsigned char *data;
+      unsigned int x;
+
+      if(width * height + 2 > length - offset || width == 0 || height == 0) {
+         break;
+      }
+
+      /* Images are stored in reverse order. */
+      if(matched == imageCount) {
+         return 0;
+      }
+      image = icon->images;
+      for(x = matched + 1; x < imageCount; x++) {
+         image = image->next;
+      }
+      if(image->width != width || image->height != height) {
+         return 0;
+      }
+
+      data = image->data;
+      offset += 2;
+      for(x = 0; x < width * height; x++) {
+         const unsigned long value = ((unsigned long)data[0] << 24)
+                                   | ((unsigned long)data[1] << 16)
+                                   | ((unsigned long)data[2] << 8)
+                                   | (unsigned long)data[3];
+         if(value != (input[offset] & 0xFFFFFFFF)) {
+            return 0;
+         }
+         data += 4;
+         offset += 1;
+      }
+      matched += 1;
+   }
+
+   return matched == imageCount;
+}
+
+/** Estimate the server memory used by the scaled copies of an icon. */
+unsigned long GetIconPixmapSize(const IconNode *icon)
+{
+   const ScaledIconNode *np;
+   unsigned long total = 0;
+   unsigned long pixelSize;
+   if(rootDepth > 16) {
+      pixelSize = 4;
+   } else if(rootDepth > 8) {
+      pixelSize = 2;
+   } else {
+      pixelSize = 1;
+   }
+   for(np = icon->nodes; np; np = np->next) {
+      const unsigned long pixels = (unsigned long)np->width * np->height;
+      total += pixels * pixelSize;
+#ifdef USE_XRENDER
+      if(icon->render) {
+         total += pixels;
+         continue;
+      }
+#endif
+      total += ((np->width + 7) / 8) * (unsigned long)np->height;
+   }
+   return total;
+}
+
 /** Read the icon WMHint property from a client. */
 IconNode *ReadWMHintIcon(Window win)
 {
    IconNode *icon = NULL;
-   XWMHints *hints = JXGetWMHints(display, win);
-   if(hints) {
+   XWMHints hints;
+   if(GetWMHints(win, &hints)) {
       Drawable d = None;
       Pixmap mask = None;
-      if(hints->flags & IconMaskHint) {
-         mask = hints->icon_mask;
+      if(hints.flags & IconMaskHint) {
+         mask = hints.icon_mask;
       }
-      if(hints->flags & IconPixmapHint) {
-         d = hints->icon_pixmap;
+      if(hints.flags & IconPixmapHint) {
+         d = hints.icon_pixmap;
       }
       if(d != None) {
          icon = CreateIconFromDrawable(d, mask);
       }
-      JXFree(hints);
    }
    return icon;
 }
@@ -557,7 +1128,6 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                               int rwidth, int rheight)
 {
 
-   XColor color;
    XImage *image;
    XPoint *points;
    ImageNode *imageNode;
@@ -568,6 +1138,7 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    int srcx, srcy;         /* Fixed point. */
    int nwidth, nheight;
    unsigned char *data;
+   unsigned char *row;
    unsigned perLine;
 
    if(rwidth == 0) {
@@ -651,9 +1222,7 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    JXSetForeground(display, maskGC, 1);
 
    /* Create a temporary XImage for scaling. */
-   image = JXCreateImage(display, rootVisual, rootDepth,
-                         ZPixmap, 0, NULL, nwidth, nheight, 8, 0);
-   image->data = Allocate(sizeof(unsigned long) * nwidth * nheight);
+   image = CreateUploadImage(rootDepth, nwidth, nheight);
 
    /* Determine the scale factor. */
    scalex = (imageNode->width << 16) / nwidth;
@@ -663,8 +1232,10 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    data = imageNode->data;
    if(imageNode->bitmap) {
       perLine = (imageNode->width >> 3) + ((imageNode->width & 7) ? 1 : 0);
+      row = NULL;
    } else {
       perLine = imageNode->width;
+      row = Allocate(4 * nwidth);
    }
    srcy = 0;
    for(y = 0; y < nheight; y++) {
@@ -683,16 +1254,8 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                pindex += 1;
             }
          } else {
-            const int yindex = (srcy >> 16) * imageNode->width;
             const int index = 4 * (yindex + (srcx >> 16));
-            color.red = data[index + 1];
-            color.red |= color.red << 8;
-            color.green = data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = data[index + 3];
-            color.blue |= color.blue << 8;
-            GetColor(&color);
-            XPutPixel(image, x, y, color.pixel);
+            memcpy(&row[4 * x], &data[index], 4);
             if(data[index] >= 128) {
                points[pindex].x = x;
                points[pindex].y = y;
@@ -701,9 +1264,15 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
          }
          srcx += scalex;
       }
+      if(row) {
+         PutColorRow(image, y, row, nwidth, 0);
+      }
       JXDrawPoints(display, np->mask, maskGC, points, pindex, CoordModeOrigin);
       srcy += scaley;
    }
+   if(row) {
+      Release(row);
+   }
    Release(points);
 
    /* Release the mask GC. */
@@ -714,11 +1283,10 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                               rootDepth);
 
    /* Render the image to the color data pixmap. */
-   JXPutImage(display, np->image, rootGC, image, 0, 0, 0, 0, nwidth, nheight);   
+   PutUploadImage(np->image, rootGC, image, nwidth, nheight);
+
    /* Release the XImage. */
-   Release(image->data);
-   image->data = NULL;
-   JXDestroyImage(image);
+   DestroyUploadImage(image);
 
    if(icon->images == NULL) {
       DestroyImage(imageNode);
@@ -791,6 +1359,8 @@ IconNode *CreateIcon(const ImageNode *image)
    icon->images = NULL;
    icon->next = NULL;
    icon->prev = NULL;
+   icon->hash = 0;
+   icon->refs = 0;
    icon->width = image->width;
    icon->height = image->height;
    icon->bitmap = image->bitmap;
@@ -803,7 +1373,7 @@ IconNode *CreateIcon(const ImageNode *image)
 }
 
 /** Helper method for destroy icons. */
-void DoDestroyIcon(int index, IconNode *icon)
+void DoDestroyIcon(IconNode **bucket, IconNode *icon)
 {
    if(icon && icon != &emptyIcon) {
       while(icon->nodes) {
@@ -837,8 +1407,8 @@ void DoDestroyIcon(int index, IconNode *icon)
 
       if(icon->prev) {
          icon->prev->next = icon->next;
-      } else {
-         iconHash[index] = icon->next;
+      } else if(bucket) {
+         *bucket = icon->next;
       }
       if(icon->next) {
          icon->next->prev = icon->prev;
@@ -851,8 +1421,13 @@ void DoDestroyIcon(int index, IconNode *icon)
 void DestroyIcon(IconNode *icon)
 {
    if(icon && icon->transient) {
-      const unsigned int index = GetHash(icon->name);
-      DoDestroyIcon(index, icon);
+      if(icon->refs > 1) {
+         icon->refs -= 1;
+      } else if(icon->refs == 1) {
+         DoDestroyIcon(&sharedIcons[icon->hash & (HASH_SIZE - 1)], icon);
+      } else {
+         DoDestroyIcon(NULL, icon);
+      }
    }
 }
 
@@ -888,7 +1463,7 @@ IconNode *FindIcon(const char *name)
 }
 
 /** Get the hash for a string. */
-unsigned int GetHash(const char *str)
+unsigned int GetStringHash(const char *str)
 {
    unsigned int hash = 0;
    if(str) {
@@ -896,11 +1471,16 @@ unsigned int GetHash(const char *str)
       for(x = 0; str[x]; x++) {
          hash = (hash + (hash << 5)) ^ (unsigned int)str[x];
       }
-      hash &= (HASH_SIZE - 1);
    }
    return hash;
 }
 
+/** Get the hash bucket for an icon name. */
+unsigned int GetHash(const char *str)
+{
+   return GetStringHash(str) & (HASH_SIZE - 1);
+}
+
 /** Set the name of the default icon. */
 void SetDefaultIcon(const char *name)
 {
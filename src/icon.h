@@ -12,6 +12,15 @@
 
 struct ClientNode;
 
+/** Maximum length of _NET_WM_ICON to read (in 32-bit units). */
+#define MAX_ICON_PROPERTY_LENGTH (1 << 20)
+
+/** Length of the first read of _NET_WM_ICON (in 32-bit units).
+ * Properties that fit are read at once; larger properties are walked
+ * image by image so that only the image needed is transferred.
+ */
+#define ICON_CHUNK_LENGTH 4096
+
 /** Structure to hold a scaled icon. */
 typedef struct ScaledIconNode {
 
@@ -42,6 +51,9 @@ typedef struct IconNode {
    struct IconNode *next;         /**< The next icon in the list. */
    struct IconNode *prev;         /**< The previous icon in the list. */
 
+   unsigned int hash;             /**< Hash of the icon data if shared. */
+   unsigned int refs;             /**< Number of users if shared. */
+
    char preserveAspect;           /**< Set to preserve the aspect ratio
                                    *   of the icon when scaling. */
    char bitmap;                   /**< Set if this is a bitmap. */
@@ -96,6 +108,37 @@ void LoadIcon(struct ClientNode *np);
  */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect);
 
+/** Load an icon that will be drawn at a known size.
+ * The image is decoded for the specified size (scalable formats are
+ * rendered at that size and JPEG images are reduced while decoding).
+ * The icon is not saved in the icon hash.
+ * @param name The name of the icon to load.
+ * @param width The width the icon will be drawn at (0 for any).
+ * @param height The height the icon will be drawn at (0 for any).
+ * @param preserveAspect Set to preserve the aspect ratio when scaling.
+ * @return A pointer to the icon (NULL if not found).
+ */
+IconNode *LoadSizedIcon(const char *name, int width, int height,
+                        char preserveAspect);
+
+/** Request that a named icon be decoded ahead of time.
+ * See PreloadImage.
+ * @param name The name of the icon.
+ */
+void PreloadNamedIcon(const char *name);
+
+/** Request that an icon for LoadSizedIcon be decoded ahead of time.
+ * The arguments must match those that will be passed to LoadSizedIcon.
+ */
+void PreloadSizedIcon(const char *name, int width, int height,
+                      char preserveAspect);
+
+/** Discard an icon requested with PreloadSizedIcon.
+ * The arguments must match those passed to PreloadSizedIcon.
+ */
+void CancelPreloadedIcon(const char *name, int width, int height,
+                         char preserveAspect);
+
 /** Load the default icon.
  * @return The default icon.
  */
@@ -122,6 +165,10 @@ void SetDefaultIcon(const char *name);
 #define LoadIcon( a )                      ICON_DUMMY_FUNCTION
 #define GetDefaultIcon()                   NULL
 #define LoadNamedIcon( a, b, c )           NULL
+#define PreloadNamedIcon( a )              ICON_DUMMY_FUNCTION
+#define LoadSizedIcon( a, b, c, d )        NULL
+#define PreloadSizedIcon( a, b, c, d )     ICON_DUMMY_FUNCTION
+#define CancelPreloadedIcon( a, b, c, d )  ICON_DUMMY_FUNCTION
 #define DestroyIcon( a )                   ICON_DUMMY_FUNCTION
 #define SetDefaultIcon( a )                ICON_DUMMY_FUNCTION
 
@@ -26,6 +26,9 @@
 #  ifdef USE_RSVG
 #     include <librsvg/rsvg.h>
 #  endif
+#  ifdef USE_PTHREAD
+#     include <pthread.h>
+#  endif
 #endif /* MAKE_DEPEND */
 
 #include "image.h"
@@ -34,10 +37,64 @@
 #include "color.h"
 #include "misc.h"
 
+/* The debug allocator is not thread-safe, so preloaded images are
+ * decoded serially in debug builds. */
+#if defined(USE_PTHREAD) && !defined(DEBUG)
+#  define USE_DECODE_THREADS
+#endif
+
+/** Maximum number of threads used to decode preloaded images. */
+#define MAX_DECODE_THREADS 4
+
 typedef ImageNode *(*ImageLoader)(const char *fileName,
                                   int rwidth, int rheight,
                                   char preserveAspect);
 
+/** States of a preloaded image. */
+#define PRELOAD_PENDING    0  /**< Waiting to be decoded. */
+#define PRELOAD_DECODING   1  /**< Being decoded by a worker. */
+#define PRELOAD_DONE       2  /**< Decoded (the image may be NULL). */
+#define PRELOAD_CANCELED   3  /**< Being decoded but no longer needed. */
+
+/** An image to be decoded before it is needed. */
+typedef struct PreloadNode {
+   char *fileName;
+   int rwidth;
+   int rheight;
+   char preserveAspect;
+   char state;                   /**< The PRELOAD_* state. */
+   ImageNode *image;             /**< The decoded image (NULL if none). */
+   struct PreloadNode *next;
+} PreloadNode;
+
+static PreloadNode *preloads = NULL;
+
+static PreloadNode **FindPreload(const char *fileName,
+                                 int rwidth, int rheight,
+                                 char preserveAspect);
+static void ReleasePreload(PreloadNode *pp);
+
+#ifdef USE_DECODE_THREADS
+static pthread_mutex_t preloadMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t preloadDone = PTHREAD_COND_INITIALIZER;
+static pthread_t backgroundThread;
+static char backgroundRunning = 0;  /**< Set while the worker has work. */
+static char backgroundStarted = 0;  /**< Set if the worker must be joined. */
+static void *DecodeThread(void *arg);
+static void JoinBackgroundThread(void);
+#  define LockPreloads()   pthread_mutex_lock(&preloadMutex)
+#  define UnlockPreloads() pthread_mutex_unlock(&preloadMutex)
+#else
+#  define LockPreloads()   (void)(0)
+#  define UnlockPreloads() (void)(0)
+#endif
+
+static ImageNode *DoLoadImage(const char *fileName, int rwidth, int rheight,
+                              char preserveAspect, char threaded);
+static ImageNode *TakePreloadedImage(const char *fileName,
+                                     int rwidth, int rheight,
+                                     char preserveAspect);
+
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
 static ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
@@ -71,28 +128,30 @@ static int FreeColors(Display *d, Colormap cmap, Pixel *pixels, int n,
                       void *closure);
 #endif
 
-/* File extension to image loader mapping. */
+/* File extension to image loader mapping.
+ * Loaders that use the display cannot be run from a decode thread. */
 static const struct {
    const char *extension;
    ImageLoader loader;
+   char threadSafe;
 } IMAGE_LOADERS[] = {
 #ifdef USE_PNG
-   {".png",       LoadPNGImage      },
+   {".png",       LoadPNGImage,     1  },
 #endif
 #ifdef USE_JPEG
-   {".jpg",       LoadJPEGImage     },
-   {".jpeg",      LoadJPEGImage     },
+   {".jpg",       LoadJPEGImage,    1  },
+   {".jpeg",      LoadJPEGImage,    1  },
 #endif
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
-   {".svg",       LoadSVGImage      },
+   {".svg",       LoadSVGImage,     1  },
 #endif
 #endif
 #ifdef USE_XPM
-   {".xpm",       LoadXPMImage      },
+   {".xpm",       LoadXPMImage,     0  },
 #endif
 #ifdef USE_XBM
-   {".xbm",       LoadXBMImage      },
+   {".xbm",       LoadXBMImage,     0  },
 #endif
 };
 static const unsigned IMAGE_LOADER_COUNT = ARRAY_LENGTH(IMAGE_LOADERS);
@@ -100,6 +159,20 @@ static const unsigned IMAGE_LOADER_COUNT = ARRAY_LENGTH(IMAGE_LOADERS);
 /** Load an image from the specified file. */
 ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
                      char preserveAspect)
+{
+   ImageNode *result;
+   result = TakePreloadedImage(fileName, rwidth, rheight, preserveAspect);
+   if(result) {
+      return result;
+   }
+   return DoLoadImage(fileName, rwidth, rheight, preserveAspect, 0);
+}
+
+/** Load an image from the specified file.
+ * If threaded is set, only thread-safe loaders are used.
+ */
+ImageNode *DoLoadImage(const char *fileName, int rwidth, int rheight,
+                       char preserveAspect, char threaded)
 {
    unsigned i;
    unsigned name_length;
@@ -128,6 +201,9 @@ ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
          const unsigned offset = name_length - ext_length;
          if(!StrCmpNoCase(&fileName[offset], ext)) {
             const ImageLoader loader = IMAGE_LOADERS[i].loader;
+            if(threaded && !IMAGE_LOADERS[i].threadSafe) {
+               return NULL;
+            }
             result = (loader)(fileName, rwidth, rheight, preserveAspect);
             if(JLIKELY(result)) {
                return result;
@@ -140,6 +216,9 @@ ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
    /* We were unable to load by extension, so try everything. */
    for(i = 0; i < IMAGE_LOADER_COUNT; i++) {
       const ImageLoader loader = IMAGE_LOADERS[i].loader;
+      if(threaded && !IMAGE_LOADERS[i].threadSafe) {
+         continue;
+      }
       result = (loader)(fileName, rwidth, rheight, preserveAspect);
       if(result) {
          /* We were able to load the image, so it must have either the
@@ -154,6 +233,279 @@ ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
    return result;
 }
 
+/** Request that an image be decoded by DecodePreloadedImages. */
+void PreloadImage(const char *fileName, int rwidth, int rheight,
+                  char preserveAspect)
+{
+   PreloadNode **pp;
+   PreloadNode *np;
+
+   if(!fileName || fileName[0] == 0) {
+      return;
+   }
+   LockPreloads();
+   pp = FindPreload(fileName, rwidth, rheight, preserveAspect);
+   if(*pp) {
+      /* Still wanted after all. */
+      if((*pp)->state == PRELOAD_CANCELED) {
+         (*pp)->state = PRELOAD_DECODING;
+      }
+      UnlockPreloads();
+      return;
+   }
+
+   np = Allocate(sizeof(PreloadNode));
+   np->fileName = CopyString(fileName);
+   np->rwidth = rwidth;
+   np->rheight = rheight;
+   np->preserveAspect = preserveAspect;
+   np->state = PRELOAD_PENDING;
+   np->image = NULL;
+   np->next = preloads;
+   preloads = np;
+   UnlockPreloads();
+}
+
+/** Find a preloaded image.
+ * This must be called with the preload list locked.
+ * @return The link to the node (pointing to NULL if not found).
+ */
+PreloadNode **FindPreload(const char *fileName, int rwidth, int rheight,
+                          char preserveAspect)
+{
+   PreloadNode **pp;
+   for(pp = &preloads; *pp; pp = &(*pp)->next) {
+      const PreloadNode *np = *pp;
+      if(np->rwidth == rwidth && np->rheight == rheight
+         && np->preserveAspect == preserveAspect
+         && !strcmp(np->fileName, fileName)) {
+         break;
+      }
+   }
+   return pp;
+}
+
+/** Release a preload node that has been removed from the list. */
+void ReleasePreload(PreloadNode *pp)
+{
+   DestroyImage(pp->image);
+   Release(pp->fileName);
+   Release(pp);
+}
+
+/** Decode preloaded images from a worker thread.
+ * arg is non-NULL for the background worker.
+ */
+#ifdef USE_DECODE_THREADS
+void *DecodeThread(void *arg)
+{
+   for(;;) {
+      PreloadNode *pp;
+      ImageNode *image;
+
+      pthread_mutex_lock(&preloadMutex);
+      for(pp = preloads; pp; pp = pp->next) {
+         if(pp->state == PRELOAD_PENDING) {
+            break;
+         }
+      }
+      if(pp) {
+         pp->state = PRELOAD_DECODING;
+      } else if(arg) {
+         backgroundRunning = 0;
+      }
+      pthread_mutex_unlock(&preloadMutex);
+      if(!pp) {
+         break;
+      }
+
+      /* The node is not removed while it is being decoded. */
+      image = DoLoadImage(pp->fileName, pp->rwidth, pp->rheight,
+                          pp->preserveAspect, 1);
+
+      pthread_mutex_lock(&preloadMutex);
+      pp->image = image;
+      if(pp->state == PRELOAD_CANCELED) {
+         PreloadNode **np = &preloads;
+         while(*np != pp) {
+            np = &(*np)->next;
+         }
+         *np = pp->next;
+      } else {
+         pp->state = PRELOAD_DONE;
+         pthread_cond_broadcast(&preloadDone);
+         pp = NULL;
+      }
+      pthread_mutex_unlock(&preloadMutex);
+      if(pp) {
+         ReleasePreload(pp);
+      }
+   }
+   return NULL;
+}
+
+/** Wait for the background worker to exit. */
+void JoinBackgroundThread(void)
+{
+   if(backgroundStarted) {
+      pthread_join(backgroundThread, NULL);
+      backgroundStarted = 0;
+   }
+}
+#endif /* USE_DECODE_THREADS */
+
+/** Decode all preloaded images. */
+void DecodePreloadedImages(void)
+{
+#ifdef USE_DECODE_THREADS
+
+   pthread_t threads[MAX_DECODE_THREADS];
+   PreloadNode *pp;
+   long cpus;
+   int count, started, i;
+
+   count = 0;
+   pthread_mutex_lock(&preloadMutex);
+   for(pp = preloads; pp; pp = pp->next) {
+      count += pp->state == PRELOAD_PENDING;
+   }
+   pthread_mutex_unlock(&preloadMutex);
+   cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   count = Min(count, MAX_DECODE_THREADS);
+   count = Min(count, Max(cpus, 1));
+
+   /* Decode on this thread as well as the workers. */
+   started = 0;
+   for(i = 1; i < count; i++) {
+      if(pthread_create(&threads[started], NULL, DecodeThread, NULL) == 0) {
+         started += 1;
+      }
+   }
+   DecodeThread(NULL);
+   for(i = 0; i < started; i++) {
+      pthread_join(threads[i], NULL);
+   }
+
+#else
+
+   PreloadNode *pp;
+   for(pp = preloads; pp; pp = pp->next) {
+      if(pp->state == PRELOAD_PENDING) {
+         pp->image = DoLoadImage(pp->fileName, pp->rwidth, pp->rheight,
+                                 pp->preserveAspect, 0);
+         pp->state = PRELOAD_DONE;
+      }
+   }
+
+#endif /* USE_DECODE_THREADS */
+}
+
+/** Start decoding preloaded images without waiting for them. */
+void DecodePreloadedImagesInBackground(void)
+{
+#ifdef USE_DECODE_THREADS
+   pthread_mutex_lock(&preloadMutex);
+   if(backgroundRunning) {
+      /* The worker will pick up the new requests. */
+      pthread_mutex_unlock(&preloadMutex);
+      return;
+   }
+   pthread_mutex_unlock(&preloadMutex);
+
+   /* The previous worker has run out of work; wait for it to exit. */
+   JoinBackgroundThread();
+   backgroundRunning = 1;
+   if(pthread_create(&backgroundThread, NULL, DecodeThread,
+                     &backgroundRunning) == 0) {
+      backgroundStarted = 1;
+   } else {
+      backgroundRunning = 0;
+   }
+#endif
+}
+
+/** Remove an image from the preload list.
+ * Images still waiting to be decoded are removed as well since the
+ * caller will decode them. If the image is being decoded, this waits
+ * for the decode to finish rather than decoding it again.
+ */
+ImageNode *TakePreloadedImage(const char *fileName, int rwidth, int rheight,
+                              char preserveAspect)
+{
+   PreloadNode **pp;
+   PreloadNode *np;
+   ImageNode *result;
+
+   if(!fileName) {
+      return NULL;
+   }
+   LockPreloads();
+   np = *FindPreload(fileName, rwidth, rheight, preserveAspect);
+#ifdef USE_DECODE_THREADS
+   if(np && np->state == PRELOAD_CANCELED) {
+      np->state = PRELOAD_DECODING;
+   }
+   while(np && np->state == PRELOAD_DECODING) {
+      pthread_cond_wait(&preloadDone, &preloadMutex);
+   }
+#endif
+   if(!np) {
+      UnlockPreloads();
+      return NULL;
+   }
+
+   /* Only this thread removes nodes that are not being decoded. */
+   pp = FindPreload(fileName, rwidth, rheight, preserveAspect);
+   *pp = np->next;
+   UnlockPreloads();
+
+   result = np->image;
+   np->image = NULL;
+   ReleasePreload(np);
+   return result;
+}
+
+/** Discard a preloaded image that is no longer needed. */
+void CancelPreloadedImage(const char *fileName, int rwidth, int rheight,
+                          char preserveAspect)
+{
+   PreloadNode **pp;
+   PreloadNode *np;
+
+   if(!fileName) {
+      return;
+   }
+   LockPreloads();
+   pp = FindPreload(fileName, rwidth, rheight, preserveAspect);
+   np = *pp;
+   if(np && (np->state == PRELOAD_DECODING
+             || np->state == PRELOAD_CANCELED)) {
+      /* The worker releases the image when it is done. */
+      np->state = PRELOAD_CANCELED;
+      np = NULL;
+   } else if(np) {
+      *pp = np->next;
+   }
+   UnlockPreloads();
+   if(np) {
+      ReleasePreload(np);
+   }
+}
+
+/** Discard preloaded images that were not used. */
+void DiscardPreloadedImages(void)
+{
+#ifdef USE_DECODE_THREADS
+   /* Let the background worker finish so no node is in use. */
+   JoinBackgroundThread();
+#endif
+   while(preloads) {
+      PreloadNode *next = preloads->next;
+      ReleasePreload(preloads);
+      preloads = next;
+   }
+}
+
 /** Load an image from a pixmap. */
 #ifdef USE_ICONS
 ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
@@ -186,20 +538,20 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
 #endif
 
 /** Load a PNG image from the given file name.
- * Since libpng uses longjmp, this function is not reentrant to simplify
- * the issues surrounding longjmp and local variables.
+ * Since libpng uses longjmp, variables modified after the setjmp are
+ * volatile. This function must be reentrant for DecodePreloadedImages.
  */
 #ifdef USE_PNG
 ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
                         char preserveAspect)
 {
 
-   static ImageNode *result;
-   static FILE *fd;
-   static unsigned char **rows;
-   static png_structp pngData;
-   static png_infop pngInfo;
-   static png_infop pngEndInfo;
+   ImageNode *volatile result;
+   unsigned char **volatile rows;
+   FILE *fd;
+   png_structp pngData;
+   png_infop pngInfo;
+   png_infop pngEndInfo;
 
    unsigned char header[8];
    unsigned long rowBytes;
@@ -211,11 +563,7 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    Assert(fileName);
 
    result = NULL;
-   fd = NULL;
    rows = NULL;
-   pngData = NULL;
-   pngInfo = NULL;
-   pngEndInfo = NULL;
 
    fd = fopen(fileName, "rb");
    if(!fd) {
@@ -235,19 +583,6 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
       return NULL;
    }
 
-   if(JUNLIKELY(setjmp(png_jmpbuf(pngData)))) {
-      png_destroy_read_struct(&pngData, &pngInfo, &pngEndInfo);
-      if(fd) {
-         fclose(fd);
-      }
-      if(rows) {
-         ReleaseStack(rows);
-      }
-      DestroyImage(result);
-      Warning(_("error reading PNG image: %s"), fileName);
-      return NULL;
-   }
-
    pngInfo = png_create_info_struct(pngData);
    if(JUNLIKELY(!pngInfo)) {
       png_destroy_read_struct(&pngData, NULL, NULL);
@@ -264,6 +599,17 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
       return NULL;
    }
 
+   if(JUNLIKELY(setjmp(png_jmpbuf(pngData)))) {
+      png_destroy_read_struct(&pngData, &pngInfo, &pngEndInfo);
+      fclose(fd);
+      if(rows) {
+         ReleaseStack(rows);
+      }
+      DestroyImage(result);
+      Warning(_("error reading PNG image: %s"), fileName);
+      return NULL;
+   }
+
    png_init_io(pngData, fd);
    png_set_sig_bytes(pngData, sizeof(header));
 
@@ -307,7 +653,6 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    fclose(fd);
 
    ReleaseStack(rows);
-   rows = NULL;
 
    return result;
 
@@ -331,12 +676,13 @@ ImageNode *LoadJPEGImage(const char *fileName,
                          int rwidth, int rheight,
                          char preserveAspect)
 {
-   static ImageNode *result;
-   static struct jpeg_decompress_struct cinfo;
-   static FILE *fd;
-   static JSAMPARRAY buffer;
-   static JPEGErrorStruct jerr;
+   ImageNode *volatile result;
+   struct jpeg_decompress_struct cinfo;
+   FILE *fd;
+   JSAMPARRAY buffer;
+   JPEGErrorStruct jerr;
 
+   unsigned char *data;
    int rowStride;
    int x;
    int inIndex, outIndex;
@@ -349,7 +695,6 @@ ImageNode *LoadJPEGImage(const char *fileName,
 
    /* Make sure everything is initialized so we can recover from errors. */
    result = NULL;
-   buffer = NULL;
 
    /* Setup the error handler. */
    cinfo.err = jpeg_std_error(&jerr.pub);
@@ -371,24 +716,31 @@ ImageNode *LoadJPEGImage(const char *fileName,
    jpeg_read_header(&cinfo, TRUE);
 
    /* Pick an appropriate scale for the image.
-    * We scale the image by the scale value for the dimension with
-    * the smallest absolute change.
+    * libjpeg can scale by n/8 (n in [1..8]) while decoding, which is much
+    * cheaper than decoding the whole image and scaling it afterwards.
+    * We use the smallest scale that still covers the requested size so
+    * that the final scaling never has to enlarge the image.
     */
    jpeg_calc_output_dimensions(&cinfo);
-   if(rwidth != 0 && rheight != 0 &&
-      (!( (rwidth == cinfo.output_width) &&
-          (rheight == cinfo.output_height) ))
-      ) {
-      /* Scale using n/8 with n in [1..8]. */
-      int ratio;
-      if(abs((int)cinfo.output_width - rwidth)
-            < abs((int)cinfo.output_height - rheight)) {
-         ratio = (rwidth << 4) / cinfo.output_width;
+   if(rwidth != 0 || rheight != 0) {
+      const int width = cinfo.output_width;
+      const int height = cinfo.output_height;
+      const int xnum = (rwidth * 8 + width - 1) / width;
+      const int ynum = (rheight * 8 + height - 1) / height;
+      int num;
+      if(rwidth == 0) {
+         num = ynum;
+      } else if(rheight == 0) {
+         num = xnum;
+      } else if(preserveAspect) {
+         num = Min(xnum, ynum);
       } else {
-         ratio = (rheight << 4) / cinfo.output_height;
+         num = Max(xnum, ynum);
+      }
+      if(num < 8) {
+         cinfo.scale_num = Max(1, num);
+         cinfo.scale_denom = 8;
       }
-      cinfo.scale_num = Max(1, Min(8, (ratio >> 2)));
-      cinfo.scale_denom = 8;
    }
 
    /* Start decompression. */
@@ -398,28 +750,29 @@ ImageNode *LoadJPEGImage(const char *fileName,
                                        JPOOL_IMAGE, rowStride, 1);
 
    result = CreateImage(cinfo.output_width, cinfo.output_height, 0);
+   data = result->data;
 
    /* Read lines. */
    outIndex = 0;
    while(cinfo.output_scanline < cinfo.output_height) {
       jpeg_read_scanlines(&cinfo, buffer, 1);
       inIndex = 0;
-      for(x = 0; x < result->width; x++) {
+      for(x = 0; x < cinfo.output_width; x++) {
          switch(cinfo.output_components) {
          case 1:  /* Grayscale. */
-            result->data[outIndex + 1] = GETJSAMPLE(buffer[0][inIndex]);
-            result->data[outIndex + 2] = GETJSAMPLE(buffer[0][inIndex]);
-            result->data[outIndex + 3] = GETJSAMPLE(buffer[0][inIndex]);
+            data[outIndex + 1] = GETJSAMPLE(buffer[0][inIndex]);
+            data[outIndex + 2] = GETJSAMPLE(buffer[0][inIndex]);
+            data[outIndex + 3] = GETJSAMPLE(buffer[0][inIndex]);
             inIndex += 1;
             break;
          default: /* RGB */
-            result->data[outIndex + 1] = GETJSAMPLE(buffer[0][inIndex + 0]);
-            result->data[outIndex + 2] = GETJSAMPLE(buffer[0][inIndex + 1]);
-            result->data[outIndex + 3] = GETJSAMPLE(buffer[0][inIndex + 2]);
+            data[outIndex + 1] = GETJSAMPLE(buffer[0][inIndex + 0]);
+            data[outIndex + 2] = GETJSAMPLE(buffer[0][inIndex + 1]);
+            data[outIndex + 3] = GETJSAMPLE(buffer[0][inIndex + 2]);
             inIndex += 3;
             break;
          }
-         result->data[outIndex + 0] = 0xFF;
+         data[outIndex + 0] = 0xFF;
          outIndex += 4;
       }
    }
@@ -512,14 +865,16 @@ ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
       yscale = xscale;
       rheight = dim.height * yscale;
    } else if(preserveAspect) {
-      if(abs(dim.width - rwidth) < abs(dim.height - rheight)) {
-         xscale = (float)rwidth / dim.width;
-         rheight = dim.height * xscale;
+      /* Fit the image within the requested size. */
+      xscale = (float)rwidth / dim.width;
+      yscale = (float)rheight / dim.height;
+      if(xscale < yscale) {
+         rheight = Max(1, dim.height * xscale);
+         yscale = xscale;
       } else {
-         xscale = (float)rheight / dim.height;
-         rwidth = dim.width * xscale;
+         rwidth = Max(1, dim.width * yscale);
+         xscale = yscale;
       }
-      yscale = xscale;
    } else {
       xscale = (float)rwidth / dim.width;
       yscale = (float)rheight / dim.height;
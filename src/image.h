@@ -34,6 +34,43 @@ typedef struct ImageNode {
 ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
                      char preserveAspect);
 
+/** Request that an image be decoded ahead of time.
+ * The decoded image is returned by the first call to LoadImage with the
+ * same arguments after DecodePreloadedImages.
+ * @param fileName The file containing the image.
+ * @param rwidth The preferred width.
+ * @param rheight The preferred height.
+ * @param preserveAspect Set to preserve image aspect when scaling.
+ */
+void PreloadImage(const char *fileName, int rwidth, int rheight,
+                  char preserveAspect);
+
+/** Decode all preloaded images.
+ * Images are decoded on worker threads if available.
+ */
+void DecodePreloadedImages(void);
+
+/** Start decoding preloaded images without waiting for them.
+ * Images are decoded on a worker thread if available. Otherwise they
+ * are decoded by LoadImage when needed.
+ */
+void DecodePreloadedImagesInBackground(void);
+
+/** Discard a preloaded image that is no longer needed.
+ * An image that is being decoded is released when the decode finishes.
+ * @param fileName The file containing the image.
+ * @param rwidth The preferred width.
+ * @param rheight The preferred height.
+ * @param preserveAspect Set to preserve image aspect when scaling.
+ */
+void CancelPreloadedImage(const char *fileName, int rwidth, int rheight,
+                          char preserveAspect);
+
+/** Discard preloaded images that were not used.
+ * This waits for any background decoding to finish.
+ */
+void DiscardPreloadedImages(void);
+
 /** Load an image from a Drawable.
  * @param pmap The drawable.
  * @param mask The mask (may be None).
@@ -143,6 +143,7 @@
 
 #include "debug.h"
 #include "jxlib.h"
+#include "prefetch.h"
 
 #endif /* JWM_H */
 
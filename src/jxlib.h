@@ -188,10 +188,21 @@
 
 #define JXGetClassHint( a, b, c ) JFUNC3(XGetClassHint, a, b, c)
 
-#define JXGetWindowAttributes( a, b, c ) JFUNC3(XGetWindowAttributes, a, b, c)
+#ifdef USE_XCB
+#  define JXGetWindowAttributes( a, b, c ) \
+   JFUNC3(GetPrefetchedWindowAttributes, a, b, c)
+#else
+#  define JXGetWindowAttributes( a, b, c ) \
+   JFUNC3(XGetWindowAttributes, a, b, c)
+#endif
 
-#define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
+#ifdef USE_XCB
+#  define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
+   JFUNC12(GetPrefetchedProperty, a, b, c, d, e, f, g, h, i, j, k, l)
+#else
+#  define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
    JFUNC12(XGetWindowProperty, a, b, c, d, e, f, g, h, i, j, k, l)
+#endif
 
 #define JXGetWMColormapWindows( a, b, c, d ) \
    JFUNC4(XGetWMColormapWindows, a, b, c, d)
@@ -225,6 +236,7 @@
 #define JXInstallColormap( a, b ) JFUNC2(XInstallColormap, a, b)
 
 #define JXInternAtom( a, b, c ) JFUNC3(XInternAtom, a, b, c)
+#define JXInternAtoms( a, b, c, d, e ) JFUNC5(XInternAtoms, a, b, c, d, e)
 
 #define JXKeysymToKeycode( a, b ) JFUNC2(XKeysymToKeycode, a, b)
 
@@ -292,6 +304,8 @@
 
 #define JXSetErrorHandler( a ) JFUNC1(XSetErrorHandler, a)
 
+#define JXSetFillStyle( a, b, c ) JFUNC3(XSetFillStyle, a, b, c)
+
 #define JXSetFont( a, b, c ) JFUNC3(XSetFont, a, b, c)
 
 #define JXSetForeground( a, b, c ) JFUNC3(XSetForeground, a, b, c)
@@ -300,6 +314,10 @@
 
 #define JXSetInputFocus( a, b, c, d ) JFUNC4(XSetInputFocus, a, b, c, d)
 
+#define JXSetTile( a, b, c ) JFUNC3(XSetTile, a, b, c)
+
+#define JXSetTSOrigin( a, b, c, d ) JFUNC4(XSetTSOrigin, a, b, c, d)
+
 #define JXSetWindowBackground( a, b, c ) JFUNC3(XSetWindowBackground, a, b, c)
 
 #define JXSetWindowBackgroundPixmap( a, b, c ) JFUNC3(XSetWindowBackgroundPixmap, a, b, c)
@@ -415,4 +433,18 @@
 #define JXRenderComposite( a, b, c, d, e, f, g, h, i, j, k, l, m ) \
    JFUNC13(XRenderComposite, a, b, c, d, e, f, g, h, i, j, k, l, m)
 
+/* MIT-SHM */
+
+#define JXShmQueryExtension( a ) JFUNC1(XShmQueryExtension, a)
+
+#define JXShmAttach( a, b ) JFUNC2(XShmAttach, a, b)
+
+#define JXShmDetach( a, b ) JFUNC2(XShmDetach, a, b)
+
+#define JXShmCreateImage( a, b, c, d, e, f, g, h ) \
+   JFUNC8(XShmCreateImage, a, b, c, d, e, f, g, h)
+
+#define JXShmPutImage( a, b, c, d, e, f, g, h, i, j, k ) \
+   JFUNC11(XShmPutImage, a, b, c, d, e, f, g, h, i, j, k)
+
 #endif /* JXLIB_H */
@@ -47,6 +47,7 @@ static const StringMappingType TOKEN_MAP[] = {
    { "Exit",                 TOK_EXIT                 },
    { "FocusModel",           TOK_FOCUSMODEL           },
    { "Font",                 TOK_FONT                 },
+   { "FontCacheSize",        TOK_FONTCACHESIZE        },
    { "Foreground",           TOK_FOREGROUND           },
    { "Group",                TOK_GROUP                },
    { "Height",               TOK_HEIGHT               },
@@ -43,6 +43,7 @@ typedef enum {
    TOK_EXIT,
    TOK_FOCUSMODEL,
    TOK_FONT,
+   TOK_FONTCACHESIZE,
    TOK_FOREGROUND,
    TOK_GROUP,
    TOK_HEIGHT,
@@ -24,6 +24,7 @@
 #include "group.h"
 #include "binding.h"
 #include "icon.h"
+#include "image.h"
 #include "taskbar.h"
 #include "tray.h"
 #include "traybutton.h"
@@ -39,8 +40,11 @@
 #include "misc.h"
 #include "background.h"
 #include "settings.h"
+#include "spatial.h"
 #include "timing.h"
 #include "grab.h"
+#include "gradient.h"
+#include "upload.h"
 
 #include <errno.h>
 
@@ -69,6 +73,7 @@ char *exitCommand = NULL;
 
 XContext clientContext;
 XContext frameContext;
+XContext transientContext;
 
 #ifdef USE_SHAPE
 char haveShape;
@@ -89,8 +94,10 @@ static Bool SelectionReleased(Display *d, XEvent *e, XPointer arg);
 static void StartupConnection(void);
 static void ShutdownConnection(void);
 static void EventLoop(void);
+#ifndef USE_EPOLL
 static void HandleExit(int sig);
 static void HandleChild(int sig);
+#endif
 static void DoExit(int code);
 static void SendRestart(void);
 static void SendExit(void);
@@ -322,7 +329,9 @@ void StartupConnection(void)
    int renderEvent;
    int renderError;
 #endif
+#ifndef USE_EPOLL
    struct sigaction sa;
+#endif
    char name[32];
    Window win;
    XEvent event;
@@ -378,6 +387,7 @@ void StartupConnection(void)
 
    clientContext = XUniqueContext();
    frameContext = XUniqueContext();
+   transientContext = XUniqueContext();
 
    /* Set the events we want for the root window.
     * Note that asking for SubstructureRedirect will fail
@@ -394,6 +404,7 @@ void StartupConnection(void)
       | PointerMotionMask | PointerMotionHintMask;
    JXChangeWindowAttributes(display, rootWindow, CWEventMask, &attr);
 
+#ifndef USE_EPOLL
    memset(&sa, 0, sizeof(sa));
    sa.sa_flags = 0;
    sa.sa_handler = HandleExit;
@@ -403,6 +414,10 @@ void StartupConnection(void)
 
    sa.sa_handler = HandleChild;
    sigaction(SIGCHLD, &sa, NULL);
+#endif
+
+   /* With epoll, signals are delivered through the event loop. */
+   StartupEventLoop();
 
 #ifdef USE_SHAPE
    haveShape = JXShapeQueryExtension(display, &shapeEvent, &shapeError);
@@ -443,9 +458,12 @@ void CloseConnection(void)
 /** Close the X server connection. */
 void ShutdownConnection(void)
 {
+   ShutdownEventLoop();
    CloseConnection();
 }
 
+#ifndef USE_EPOLL
+
 /** Signal handler. */
 void HandleExit(int sig)
 {
@@ -460,6 +478,8 @@ void HandleChild(int sig)
    errno = savedErrno;
 }
 
+#endif /* USE_EPOLL */
+
 /** Initialize data structures.
  * This is called before the X connection is opened.
  */
@@ -480,6 +500,7 @@ void Initialize(void)
 #endif
    InitializeDock();
    InitializeFonts();
+   InitializeGradients();
    InitializeGroups();
    InitializeHints();
    InitializeIcons();
@@ -489,10 +510,12 @@ void Initialize(void)
    InitializeRootMenu();
    InitializeScreens();
    InitializeSettings();
+   InitializeSpatial();
    InitializeSwallow();
    InitializeTaskBar();
    InitializeTray();
    InitializeTrayButtons();
+   InitializeUpload();
 }
 
 /** Startup the various JWM components.
@@ -501,20 +524,34 @@ void Initialize(void)
 void Startup(void)
 {
 
-   /* This order is important. */
+   TimeType start, now;
+   GetCurrentTime(&start);
 
-   /* First we grab the server to prevent clients from changing things
-    * while we're still loading. */
-   GrabServer();
+   /* This order is important. */
 
    StartupSettings();
    StartupScreens();
 
-   StartupGroups();
+   /* Load fonts and decode images before grabbing the server since
+    * these are slow and do not depend on other clients. */
    StartupColors();
+   StartupGradients();
    StartupFonts();
+   StartupUpload();
    StartupIcons();
+   PreloadBackgrounds();
+   PreloadTrayButtons();
+   PreloadRootMenu();
+   DecodePreloadedImages();
+   GetCurrentTime(&now);
+   Debug("preload took %lu ms", GetTimeDifference(&now, &start));
    StartupBackgrounds();
+
+   /* Grab the server to prevent clients from changing things
+    * while we're still loading. */
+   GrabServer();
+
+   StartupGroups();
    StartupCursors();
 
    StartupPager();
@@ -528,6 +565,7 @@ void Startup(void)
    StartupBindings();
    StartupBorders();
    StartupPlacement();
+   StartupSpatial();
    StartupClients();
 
 #  ifndef DISABLE_CONFIRM
@@ -556,10 +594,14 @@ void Startup(void)
 
    /* Draw the background (if backgrounds are used). */
    LoadBackground(currentDesktop);
+   DiscardPreloadedImages();
 
    /* Run any startup commands. */
    StartupCommands();
 
+   GetCurrentTime(&now);
+   Debug("startup took %lu ms", GetTimeDifference(&now, &start));
+
 }
 
 /** Shutdown the various JWM components.
@@ -586,10 +628,13 @@ void Shutdown(void)
    ShutdownClock();
    ShutdownBorders();
    ShutdownClients();
+   ShutdownSpatial();
    ShutdownBackgrounds();
    ShutdownIcons();
+   ShutdownUpload();
    ShutdownCursors();
    ShutdownFonts();
+   ShutdownGradients();
    ShutdownColors();
    ShutdownGroups();
    ShutdownDesktops();
@@ -622,6 +667,7 @@ void Destroy(void)
 #endif
    DestroyDock();
    DestroyFonts();
+   DestroyGradients();
    DestroyGroups();
    DestroyHints();
    DestroyIcons();
@@ -632,10 +678,12 @@ void Destroy(void)
    DestroyRootMenu();
    DestroyScreens();
    DestroySettings();
+   DestroySpatial();
    DestroySwallow();
    DestroyTaskBar();
    DestroyTray();
    DestroyTrayButtons();
+   DestroyUpload();
 }
 
 /** Send _JWM_RESTART to the root window. */
@@ -35,6 +35,7 @@ extern char initializing;
 
 extern XContext clientContext;
 extern XContext frameContext;
+extern XContext transientContext;
 
 #ifdef USE_SHAPE
 extern char haveShape;
@@ -9,32 +9,33 @@
 
 #include "jwm.h"
 #include "match.h"
+#include "error.h"
 
-#include <regex.h>
-
-/** Determine if expression matches pattern. */
-char Match(const char *pattern, const char *expression)
+/** Compile a pattern. */
+char CompilePattern(regex_t *re, const char *pattern)
 {
-
-   regex_t re;
-   regmatch_t rm;
+   char message[128];
    int rc;
 
-   if(!pattern && !expression) {
-      return 1;
-   } else if(!pattern || !expression) {
+   Assert(re);
+   Assert(pattern);
+
+   rc = regcomp(re, pattern, REG_EXTENDED | REG_NOSUB);
+   if(JUNLIKELY(rc != 0)) {
+      regerror(rc, re, message, sizeof(message));
+      Warning(_("invalid pattern \"%s\": %s"), pattern, message);
       return 0;
    }
+   return 1;
+}
 
-   if(regcomp(&re, pattern, REG_EXTENDED) != 0) {
+/** Determine if an expression matches a compiled pattern. */
+char MatchPattern(const regex_t *re, const char *expression)
+{
+   Assert(re);
+   if(!expression) {
       return 0;
    }
-
-   rc = regexec(&re, expression, 0, &rm, 0);
-
-   regfree(&re);
-
-   return rc == 0 ? 1 : 0;
-
+   return regexec(re, expression, 0, NULL, 0) == 0 ? 1 : 0;
 }
 
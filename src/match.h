@@ -10,12 +10,21 @@
 #ifndef MATCH_H
 #define MATCH_H
 
-/** Check if an expression matches a pattern.
- * @param pattern The pattern to match against.
- * @param expression The expression to check.
+#include <regex.h>
+
+/** Compile a pattern for matching.
+ * A warning is displayed if the pattern is invalid.
+ * @param re The compiled pattern to initialize (release with regfree).
+ * @param pattern The pattern to compile.
+ * @return 1 if the pattern was compiled, 0 otherwise.
+ */
+char CompilePattern(regex_t *re, const char *pattern);
+
+/** Check if an expression matches a compiled pattern.
+ * @param re The compiled pattern to match against.
+ * @param expression The expression to check (may be NULL).
  * @return 1 if there is a match, 0 otherwise.
  */
-char Match(const char *pattern, const char *expression);
+char MatchPattern(const regex_t *re, const char *expression);
 
 #endif /* MATCH_H */
-
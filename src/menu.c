@@ -83,6 +83,24 @@ MenuItem *CreateMenuItem(MenuItemType type)
    return item;
 }
 
+/** Request that menu icons be decoded ahead of time. */
+void PreloadMenu(Menu *menu)
+{
+   MenuItem *np;
+   for(np = menu->items; np; np = np->next) {
+      PreloadNamedIcon(np->iconName);
+      if(np->submenu) {
+         PreloadMenu(np->submenu);
+      }
+   }
+}
+
+/** Get the size at which menus without a user height draw icons. */
+int GetMenuIconSize(void)
+{
+   return GetStringHeight(FONT_MENU) + BASE_ICON_OFFSET * 2;
+}
+
 /** Initialize a menu. */
 void InitializeMenu(Menu *menu)
 {
@@ -298,6 +316,7 @@ char ShowSubmenu(Menu *menu, Menu *parent,
    menuShown -= 1;
 
    JXDestroyWindow(display, menu->window);
+   ReleaseStringContext(menu->pixmap);
    JXFreePixmap(display, menu->pixmap);
 
    return status;
@@ -116,11 +116,22 @@ Menu *CreateMenu();
 /** Create an empty menu item. */
 MenuItem *CreateMenuItem(MenuItemType type);
 
+/** Request that the icons for a menu be decoded ahead of time.
+ * @param menu The menu.
+ */
+void PreloadMenu(Menu *menu);
+
 /** Initialize a menu structure to be shown.
  * @param menu The menu to initialize.
  */
 void InitializeMenu(Menu *menu);
 
+/** Get the size at which menus without a user height draw icons.
+ * This is the size used for client icons in window lists.
+ * @return The icon size in pixels.
+ */
+int GetMenuIconSize(void);
+
 /** Show a menu.
  * @param menu The menu to show.
  * @param runner Callback executed when an item is selected.
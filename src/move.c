@@ -23,6 +23,7 @@
 #include "tray.h"
 #include "desktop.h"
 #include "settings.h"
+#include "spatial.h"
 #include "timing.h"
 
 typedef struct {
@@ -443,6 +444,7 @@ void StopMove(ClientNode *np, int doMove, int oldx, int oldy)
    if(!doMove) {
       np->x = oldx;
       np->y = oldy;
+      UpdateClientIndex(np);
       return;
    }
 
@@ -533,11 +535,14 @@ void DoSnapBorder(ClientNode *np)
 
    const ClientNode *tp;
    const TrayType *tray;
+   ClientNode **candidates;
    RectangleType client, other;
    RectangleType left = { 0 };
    RectangleType right = { 0 };
    RectangleType top = { 0 };
    RectangleType bottom = { 0 };
+   unsigned int count, index;
+   int distance;
    int layer;
    int north, south, east, west;
 
@@ -547,6 +552,18 @@ void DoSnapBorder(ClientNode *np)
 
    other.valid = 1;
 
+   /* Only windows within the snap distance can change the result.
+    * Windows on other desktops are hidden, so only the current desktop
+    * (and sticky windows) need to be considered. */
+   distance = settings.snapDistance + 1;
+   candidates = GetClientsInRect(currentDesktop,
+                                 client.left - distance,
+                                 client.top - distance,
+                                 client.right - client.left + 2 * distance,
+                                 client.bottom - client.top + 2 * distance,
+                                 0, &count);
+   index = 0;
+
    /* Work from the bottom of the window stack to the top. */
    for(layer = 0; layer < LAYER_COUNT; layer++) {
 
@@ -587,8 +604,10 @@ void DoSnapBorder(ClientNode *np)
       }
 
       /* Check client windows. */
-      for(tp = nodeTail[layer]; tp; tp = tp->prev) {
+      for(; index < count && candidates[index]->state.layer <= layer;
+          index++) {
 
+         tp = candidates[index];
          if(tp == np || !ShouldSnap(tp)) {
             continue;
          }
@@ -21,6 +21,7 @@
 #include "popup.h"
 #include "font.h"
 #include "settings.h"
+#include "spatial.h"
 
 /** Structure to represent a pager tray component. */
 typedef struct PagerType {
@@ -37,6 +38,7 @@ typedef struct PagerType {
 
    TimeType mouseTime;     /**< Timestamp of last mouse movement. */
    int mousex, mousey;     /**< Coordinates of last mouse location. */
+   char hover;             /**< Set while the popup callback is active. */
 
    struct PagerType *next; /**< Next pager in the list. */
 
@@ -78,6 +80,7 @@ void ShutdownPager(void)
 {
    PagerType *pp;
    for(pp = pagers; pp; pp = pp->next) {
+      ReleaseStringContext(pp->buffer);
       JXFreePixmap(display, pp->buffer);
    }
 }
@@ -87,7 +90,9 @@ void DestroyPager(void)
 {
    PagerType *pp;
    while(pagers) {
-      UnregisterCallback(SignalPager, pagers);
+      if(pagers->hover) {
+         UnregisterCallback(SignalPager, pagers);
+      }
       pp = pagers->next;
       Release(pagers);
       pagers = pp;
@@ -109,6 +114,7 @@ TrayComponentType *CreatePager(char labeled)
    pp->mousey = -settings.doubleClickDelta;
    pp->mouseTime.seconds = 0;
    pp->mouseTime.ms = 0;
+   pp->hover = 0;
    pp->buffer = None;
 
    cp = CreateTrayComponent();
@@ -119,8 +125,6 @@ TrayComponentType *CreatePager(char labeled)
    cp->ProcessButtonPress = ProcessPagerButtonEvent;
    cp->ProcessMotionEvent = ProcessPagerMotionEvent;
 
-   RegisterCallback(settings.popupDelay / 2, SignalPager, pp);
-
    return cp;
 }
 
@@ -178,6 +182,7 @@ void SetSize(TrayComponentType *cp, int width, int height)
    }
 
    if(pp->buffer != None) {
+      ReleaseStringContext(pp->buffer);
       JXFreePixmap(display, pp->buffer);
       pp->buffer = JXCreatePixmap(display, rootWindow, cp->width,
                                   cp->height, rootDepth);
@@ -250,6 +255,12 @@ void ProcessPagerMotionEvent(TrayComponentType *cp, int x, int y, int mask)
    pp->mousex = cp->screenx + x;
    pp->mousey = cp->screeny + y;
    GetCurrentTime(&pp->mouseTime);
+
+   /* Watch for popups while the mouse is over the pager. */
+   if(!pp->hover) {
+      pp->hover = 1;
+      RegisterCallback(settings.popupDelay / 2, SignalPager, pp);
+   }
 }
 
 /** Start a pager move operation. */
@@ -259,8 +270,10 @@ void StartPagerMove(TrayComponentType *cp, int x, int y)
    XEvent event;
    PagerType *pp;
    ClientNode *np;
-   int layer;
+   ClientNode **candidates;
+   unsigned int count, index;
    int desktop;
+   int rx, ry;
    int cx, cy;
    int cwidth, cheight;
 
@@ -277,70 +290,84 @@ void StartPagerMove(TrayComponentType *cp, int x, int y)
    x -= (desktop % settings.desktopWidth) * (pp->deskWidth + 1);
    y -= (desktop / settings.desktopWidth) * (pp->deskHeight + 1);
 
+   /* No client is visible if the pager is too small. */
+   if(pp->scalex <= 0 || pp->scaley <= 0) {
+      return;
+   }
+
+   /* Find clients near the root coordinates of the pager location.
+    * A client can only be hit if its pager rectangle covers the point,
+    * which requires the client to be within a pager pixel of it. */
+   rx = ((x - 2) * 65536) / pp->scalex - 1;
+   ry = ((y - 2) * 65536) / pp->scaley - 1;
+   candidates = GetClientsInRect(desktop, rx, ry,
+                                 (x * 65536) / pp->scalex + 1 - rx,
+                                 (y * 65536) / pp->scaley + 1 - ry,
+                                 1, &count);
+
    /* Find the client under the specified coordinates. */
-   for(layer = LAST_LAYER; layer >= FIRST_LAYER; layer--) {
-      for(np = nodes[layer]; np; np = np->next) {
+   for(index = 0; index < count; index++) {
+      np = candidates[index];
 
-         /* Skip this client if it isn't mapped. */
-         if(!(np->state.status & STAT_MAPPED)) {
+      /* Skip this client if it isn't mapped. */
+      if(!(np->state.status & STAT_MAPPED)) {
+         continue;
+      }
+      if(np->state.status & STAT_NOPAGER) {
+         continue;
+      }
+
+      /* Skip this client if it isn't on the selected desktop. */
+      if(np->state.status & STAT_STICKY) {
+         if(currentDesktop != desktop) {
             continue;
          }
-         if(np->state.status & STAT_NOPAGER) {
+      } else {
+         if(np->state.desktop != desktop) {
             continue;
          }
+      }
 
-         /* Skip this client if it isn't on the selected desktop. */
-         if(np->state.status & STAT_STICKY) {
-            if(currentDesktop != desktop) {
-               continue;
-            }
-         } else {
-            if(np->state.desktop != desktop) {
-               continue;
-            }
-         }
-
-         /* Get the offset and size of the client on the pager. */
-         cx = 1 + ((np->x * pp->scalex) >> 16);
-         cy = 1 + ((np->y * pp->scaley) >> 16);
-         cwidth = (np->width * pp->scalex) >> 16;
-         cheight = (np->height * pp->scaley) >> 16;
+      /* Get the offset and size of the client on the pager. */
+      cx = 1 + ((np->x * pp->scalex) >> 16);
+      cy = 1 + ((np->y * pp->scaley) >> 16);
+      cwidth = (np->width * pp->scalex) >> 16;
+      cheight = (np->height * pp->scaley) >> 16;
 
-         /* Normalize the offset and size. */
-         if(cx + cwidth > pp->deskWidth) {
-            cwidth = pp->deskWidth - cx;
-         }
-         if(cy + cheight > pp->deskHeight) {
-            cheight = pp->deskHeight - cy;
-         }
-         if(cx < 0) {
-            cwidth += cx;
-            cx = 0;
-         }
-         if(cy < 0) {
-            cheight += cy;
-            cy = 0;
-         }
+      /* Normalize the offset and size. */
+      if(cx + cwidth > pp->deskWidth) {
+         cwidth = pp->deskWidth - cx;
+      }
+      if(cy + cheight > pp->deskHeight) {
+         cheight = pp->deskHeight - cy;
+      }
+      if(cx < 0) {
+         cwidth += cx;
+         cx = 0;
+      }
+      if(cy < 0) {
+         cheight += cy;
+         cy = 0;
+      }
 
-         /* Skip the client if we are no longer in bounds. */
-         if(cwidth <= 0 || cheight <= 0) {
-            continue;
-         }
+      /* Skip the client if we are no longer in bounds. */
+      if(cwidth <= 0 || cheight <= 0) {
+         continue;
+      }
 
-         /* Check the y-coordinate. */
-         if(y < cy || y > cy + cheight) {
-            continue;
-         }
+      /* Check the y-coordinate. */
+      if(y < cy || y > cy + cheight) {
+         continue;
+      }
 
-         /* Check the x-coordinate. */
-         if(x < cx || x > cx + cwidth) {
-            continue;
-         }
+      /* Check the x-coordinate. */
+      if(x < cx || x > cx + cwidth) {
+         continue;
+      }
 
-         /* Found it. Exit. */
-         goto ClientFound;
+      /* Found it. Exit. */
+      goto ClientFound;
 
-      }
    }
 
    /* Client wasn't found. Just return. */
@@ -595,6 +622,11 @@ void UpdatePager(void)
 void SignalPager(const TimeType *now, int x, int y, Window w, void *data)
 {
    PagerType *pp = (PagerType*)data;
+   if(!IsPointerOnComponent(pp->cp, x, y, w)) {
+      UnregisterCallback(SignalPager, pp);
+      pp->hover = 0;
+      return;
+   }
    if(pp->cp->tray->window == w &&
       abs(pp->mousex - x) < settings.doubleClickDelta &&
       abs(pp->mousey - y) < settings.doubleClickDelta) {
@@ -364,6 +364,9 @@ void Parse(const TokenNode *start, int depth)
             case TOK_FOCUSMODEL:
                ParseFocusModel(tp);
                break;
+            case TOK_FONTCACHESIZE:
+               settings.fontCacheSize = ParseUnsigned(tp, tp->value);
+               break;
             case TOK_GROUP:
                ParseGroup(tp);
                break;
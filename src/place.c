@@ -16,6 +16,7 @@
 #include "settings.h"
 #include "clientlist.h"
 #include "misc.h"
+#include "timing.h"
 
 typedef struct Strut {
    ClientNode *client;
@@ -23,6 +24,29 @@ typedef struct Strut {
    struct Strut *next;
 } Strut;
 
+/** Edge of a client used for tiled placement. */
+typedef struct TileEdge {
+   int y;                        /**< y-coordinate of the edge. */
+   int x1, x2;                   /**< Horizontal extent of the client. */
+   int sign;                     /**< 1 for a top edge, -1 for a bottom. */
+} TileEdge;
+
+/** Overlap of clients with a column for tiled placement.
+ * For a window spanning x1 to x2, the area it overlaps other clients
+ * below a given y is piecewise linear in y with breakpoints at client
+ * edges.  The overlap for a window from y1 to y2 is then the difference
+ * of this function at y2 and y1.
+ */
+typedef struct TileColumn {
+   const TileEdge *edges;        /**< Client edges sorted by y. */
+   int edgeCount;                /**< Number of client edges. */
+   int x1, x2;                   /**< Column for the breakpoints below. */
+   int count;                    /**< Number of breakpoints. */
+   int *ys;                      /**< y-coordinate of each breakpoint. */
+   long long *values;            /**< Overlap below each breakpoint. */
+   long long *slopes;            /**< Slope after each breakpoint. */
+} TileColumn;
+
 static Strut *struts = NULL;
 
 /* desktopCount x screenCount */
@@ -33,8 +57,12 @@ static char DoRemoveClientStrut(ClientNode *np);
 static void InsertStrut(const BoundingBox *box, ClientNode *np);
 static void CenterClient(const BoundingBox *box, ClientNode *np);
 static int IntComparator(const void *a, const void *b);
+static int TileEdgeComparator(const void *a, const void *b);
+static int RemoveDuplicates(int *values, int count);
+static void BuildTileColumn(TileColumn *column, int x1, int x2);
+static long long GetTileColumnOverlap(const TileColumn *column, int y);
 static int TryTileClient(const BoundingBox *box, ClientNode *np,
-                         int x, int y);
+                         TileColumn *column, int x, int y);
 static char TileClient(const BoundingBox *box, ClientNode *np);
 static void CascadeClient(const BoundingBox *box, ClientNode *np);
 
@@ -416,15 +444,90 @@ int IntComparator(const void *a, const void *b)
    return ia - ib;
 }
 
+/** Compare two tile edges by y-coordinate. */
+int TileEdgeComparator(const void *a, const void *b)
+{
+   const TileEdge *ea = (const TileEdge*)a;
+   const TileEdge *eb = (const TileEdge*)b;
+   return ea->y - eb->y;
+}
+
+/** Remove duplicates from a sorted array.
+ * Returns the new number of elements.
+ */
+int RemoveDuplicates(int *values, int count)
+{
+   int i, j;
+   j = 0;
+   for(i = 0; i < count; i++) {
+      if(j == 0 || values[j - 1] != values[i]) {
+         values[j] = values[i];
+         j += 1;
+      }
+   }
+   return j;
+}
+
+/** Compute the overlap breakpoints for a column. */
+void BuildTileColumn(TileColumn *column, int x1, int x2)
+{
+   long long value = 0;
+   long long slope = 0;
+   int count = 0;
+   int i;
+
+   for(i = 0; i < column->edgeCount; i++) {
+      const TileEdge *ep = &column->edges[i];
+      const int width = Min(ep->x2, x2) - Max(ep->x1, x1);
+      if(width <= 0) {
+         continue;
+      }
+      if(count == 0 || column->ys[count - 1] != ep->y) {
+         if(count > 0) {
+            value += slope * (ep->y - column->ys[count - 1]);
+         }
+         column->ys[count] = ep->y;
+         column->values[count] = value;
+         count += 1;
+      }
+      slope += ep->sign * width;
+      column->slopes[count - 1] = slope;
+   }
+
+   column->x1 = x1;
+   column->x2 = x2;
+   column->count = count;
+}
+
+/** Get the area of a column overlapping clients above y. */
+long long GetTileColumnOverlap(const TileColumn *column, int y)
+{
+   int low, high;
+
+   /* Find the last breakpoint at or above y. */
+   low = 0;
+   high = column->count;
+   while(low < high) {
+      const int mid = (low + high) / 2;
+      if(column->ys[mid] <= y) {
+         low = mid + 1;
+      } else {
+         high = mid;
+      }
+   }
+   if(low == 0) {
+      return 0;
+   }
+   low -= 1;
+   return column->values[low] + column->slopes[low] * (y - column->ys[low]);
+}
+
 /** Attempt to place the client at the specified coordinates. */
-int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y)
+int TryTileClient(const BoundingBox *box, ClientNode *np,
+                  TileColumn *column, int x, int y)
 {
-   const ClientNode *tp;
-   int layer;
    int north, south, east, west;
    int x1, x2, y1, y2;
-   int ox1, ox2, oy1, oy2;
-   int overlap;
 
    /* Set the client position. */
    GetBorderSize(&np->state, &north, &south, &east, &west);
@@ -439,8 +542,6 @@ int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y)
    y1 = np->y - north;
    y2 = np->y + np->height + south;
 
-   overlap = 0;
-
    /* Return maximum cost for window outside bounding box. */
    if (  x1 < box->x ||
          x2 > box->x + box->width ||
@@ -449,57 +550,39 @@ int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y)
        return INT_MAX;
    }
 
-   /* Loop over each client. */
-   for(layer = np->state.layer; layer < LAYER_COUNT; layer++) {
-      for(tp = nodes[layer]; tp; tp = tp->next) {
-
-         /* Skip clients that aren't visible. */
-         if(!IsClientOnCurrentDesktop(tp)) {
-            continue;
-         }
-         if(!(tp->state.status & STAT_MAPPED)) {
-            continue;
-         }
-         if(tp == np) {
-            continue;
-         }
-
-         /* Get the boundaries of the other client. */
-         GetBorderSize(&tp->state, &north, &south, &east, &west);
-         ox1 = tp->x - west;
-         ox2 = tp->x + tp->width + east;
-         oy1 = tp->y - north;
-         oy2 = tp->y + tp->height + south;
-
-         /* Check for an overlap. */
-         if(x2 <= ox1 || x1 >= ox2) {
-            continue;
-         }
-         if(y2 <= oy1 || y1 >= oy2) {
-            continue;
-         }
-         overlap += (Min(ox2, x2) - Max(ox1, x1))
-                  * (Min(oy2, y2) - Max(oy1, y1));
-      }
+   /* Update the column if the window moved horizontally.
+    * This only happens once per x-coordinate unless the window
+    * was constrained. */
+   if(x1 != column->x1 || x2 != column->x2) {
+      BuildTileColumn(column, x1, x2);
    }
-
-   return overlap;
+   return (int)(GetTileColumnOverlap(column, y2)
+              - GetTileColumnOverlap(column, y1));
 }
 
-/** Tiled placement. */
+/** Tiled placement.
+ * The overlap for each position is found with a binary search of the
+ * overlap for the column, so this takes O(n^2 log n) for n clients.
+ */
 char TileClient(const BoundingBox *box, ClientNode *np)
 {
 
    const ClientNode *tp;
+   TileColumn column;
+   TileEdge *edges;
+   TimeType start, now;
    int layer;
    int north, south, east, west;
    int i, j;
    int count;
+   int xcount, ycount;
    int *xs;
    int *ys;
    int leastOverlap;
    int bestx, besty;
 
+   GetCurrentTime(&start);
+
    /* Count insertion points, including bounding box edges. */
    count = 2;
    for(layer = np->state.layer; layer < LAYER_COUNT; layer++) {
@@ -517,9 +600,10 @@ char TileClient(const BoundingBox *box, ClientNode *np)
       }
    }
 
-   /* Allocate space for the points. */
+   /* Allocate space for the points and client edges. */
    xs = AllocateStack(sizeof(int) * count);
    ys = AllocateStack(sizeof(int) * count);
+   edges = AllocateStack(sizeof(TileEdge) * count);
 
    /* Insert points. */
    xs[0] = box->x;
@@ -541,27 +625,46 @@ char TileClient(const BoundingBox *box, ClientNode *np)
          xs[count + 1] = tp->x + tp->width + east;
          ys[count + 0] = tp->y - north;
          ys[count + 1] = tp->y + tp->height + south;
+         edges[count - 1].y = ys[count + 0];
+         edges[count - 1].sign = 1;
+         edges[count + 0].y = ys[count + 1];
+         edges[count + 0].sign = -1;
+         edges[count - 1].x1 = edges[count + 0].x1 = xs[count + 0];
+         edges[count - 1].x2 = edges[count + 0].x2 = xs[count + 1];
          count += 2;
       }
    }
 
+   /* Sort the client edges for building columns. */
+   column.edges = edges;
+   column.edgeCount = count - 1;
+   qsort(edges, column.edgeCount, sizeof(TileEdge), TileEdgeComparator);
+   column.ys = AllocateStack(sizeof(int) * (column.edgeCount + 1));
+   column.values = AllocateStack(sizeof(long long) * (column.edgeCount + 1));
+   column.slopes = AllocateStack(sizeof(long long) * (column.edgeCount + 1));
+   column.x1 = INT_MAX;
+   column.x2 = INT_MIN;
+   column.count = 0;
+
    /* Try placing at lower right edge of box, too. */
    GetBorderSize(&np->state, &north, &south, &east, &west);
    xs[count] = box->x + box->width - np->width - east - west;
    ys[count] = box->y + box->height - np->height - north - south;
    count += 1;
 
-   /* Sort the points. */
+   /* Sort the points and remove duplicates. */
    qsort(xs, count, sizeof(int), IntComparator);
    qsort(ys, count, sizeof(int), IntComparator);
+   xcount = RemoveDuplicates(xs, count);
+   ycount = RemoveDuplicates(ys, count);
 
    /* Try all possible positions. */
    leastOverlap = INT_MAX;
    bestx = xs[0];
    besty = ys[0];
-   for(i = 0; i < count; i++) {
-      for(j = 0; j < count; j++) {
-         const int overlap = TryTileClient(box, np, xs[i], ys[j]);
+   for(i = 0; i < xcount && leastOverlap > 0; i++) {
+      for(j = 0; j < ycount; j++) {
+         const int overlap = TryTileClient(box, np, &column, xs[i], ys[j]);
          if(overlap < leastOverlap) {
             leastOverlap = overlap;
             bestx = xs[i];
@@ -573,9 +676,17 @@ char TileClient(const BoundingBox *box, ClientNode *np)
       }
    }
 
+   ReleaseStack(column.ys);
+   ReleaseStack(column.values);
+   ReleaseStack(column.slopes);
+   ReleaseStack(edges);
    ReleaseStack(xs);
    ReleaseStack(ys);
 
+   GetCurrentTime(&now);
+   Debug("tiled placement with %d clients took %lu ms",
+         column.edgeCount / 2, GetTimeDifference(&now, &start));
+
    if(leastOverlap < INT_MAX) {
       /* Set the client position. */
       GetBorderSize(&np->state, &north, &south, &east, &west);
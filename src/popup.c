@@ -43,20 +43,20 @@ void StartupPopup(void)
 {
    popup.text = NULL;
    popup.window = None;
-   RegisterCallback(100, SignalPopup, NULL);
 }
 
 /** Shutdown popups. */
 void ShutdownPopup(void)
 {
-   UnregisterCallback(SignalPopup, NULL);
    if(popup.text) {
       Release(popup.text);
       Release(popup.lines);
       popup.text = NULL;
    }
    if(popup.window != None) {
+      UnregisterCallback(SignalPopup, NULL);
       JXDestroyWindow(display, popup.window);
+      ReleaseStringContext(popup.pmap);
       JXFreePixmap(display, popup.pmap);
       popup.window = None;
    }
@@ -173,10 +173,14 @@ void ShowPopup(int x, int y, const char *text,
                   ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION);
       JXMapRaised(display, popup.window);
 
+      /* Watch the pointer only while the popup is visible. */
+      RegisterCallback(100, SignalPopup, NULL);
+
    } else {
 
       JXMoveResizeWindow(display, popup.window, popup.x, popup.y,
                          popup.width, popup.height);
+      ReleaseStringContext(popup.pmap);
       JXFreePixmap(display, popup.pmap);
 
    }
@@ -209,7 +213,9 @@ void SignalPopup(const TimeType *now, int x, int y, Window w, void *data)
    if(popup.window != None) {
       if(popup.mw != w ||
          abs(popup.mx - x) > 0 || abs(popup.my - y) > 0) {
+         UnregisterCallback(SignalPopup, NULL);
          JXDestroyWindow(display, popup.window);
+         ReleaseStringContext(popup.pmap);
          JXFreePixmap(display, popup.pmap);
          popup.window = None;
       }
@@ -224,7 +230,9 @@ char ProcessPopupEvent(const XEvent *event)
          JXCopyArea(display, popup.pmap, popup.window, rootGC,
                     0, 0, popup.width, popup.height, 0, 0);
       } else if(event->type == MotionNotify) {
+         UnregisterCallback(SignalPopup, NULL);
          JXDestroyWindow(display, popup.window);
+         ReleaseStringContext(popup.pmap);
          JXFreePixmap(display, popup.pmap);
          popup.window = None;
       }
@@ -0,0 +1,405 @@
+/**
+ * @file prefetch.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pipelined property and attribute requests.
+ *
+ */
+
+#include "jwm.h"
+#include "prefetch.h"
+#include "main.h"
+#include "misc.h"
+
+#ifdef USE_XCB
+
+#include <X11/Xlib-xcb.h>
+
+#define PROPERTY_HASH_SIZE 64
+
+/** A property request (and reply once collected). */
+typedef struct PropertyNode {
+   Window window;
+   Atom atom;
+   xcb_get_property_cookie_t cookie;
+   xcb_get_property_reply_t *reply;
+   int status;                   /**< Error code if the request failed. */
+   char pending;                 /**< Set until the reply is collected. */
+   struct PropertyNode *next;
+} PropertyNode;
+
+/** A window attribute request (and replies once collected). */
+typedef struct AttributeNode {
+   Window window;
+   xcb_get_window_attributes_cookie_t attrCookie;
+   xcb_get_geometry_cookie_t geomCookie;
+   xcb_get_window_attributes_reply_t *attrReply;
+   xcb_get_geometry_reply_t *geomReply;
+   char pending;                 /**< Set until the replies are collected. */
+   struct AttributeNode *next;
+} AttributeNode;
+
+static PropertyNode *properties[PROPERTY_HASH_SIZE];
+static AttributeNode *attributes[PROPERTY_HASH_SIZE];
+
+static unsigned int GetPropertyHash(Window win, Atom atom);
+static PropertyNode *FindProperty(Window win, Atom atom);
+static void CollectProperty(PropertyNode *np);
+static char CopyProperty(const PropertyNode *np,
+                         long offset, long length, Atom reqType,
+                         Atom *actualType, int *actualFormat,
+                         unsigned long *itemCount, unsigned long *bytesLeft,
+                         unsigned char **data);
+static void ReleaseProperty(PropertyNode *np);
+static AttributeNode *FindAttributes(Window win);
+static void CollectAttributes(AttributeNode *ap);
+static Visual *FindVisual(Display *d, VisualID id);
+static void ReleaseAttributes(AttributeNode *ap);
+
+/** Get the hash bucket for a property. */
+unsigned int GetPropertyHash(Window win, Atom atom)
+{
+   return (unsigned int)((win * 31) ^ atom) % PROPERTY_HASH_SIZE;
+}
+
+/** Find a prefetched property. */
+PropertyNode *FindProperty(Window win, Atom atom)
+{
+   PropertyNode *np = properties[GetPropertyHash(win, atom)];
+   while(np) {
+      if(np->window == win && np->atom == atom) {
+         return np;
+      }
+      np = np->next;
+   }
+   return NULL;
+}
+
+/** Request a window property without waiting for the reply. */
+void PrefetchProperty(Window win, Atom atom, long length)
+{
+   const unsigned int index = GetPropertyHash(win, atom);
+   PropertyNode *np;
+
+   if(FindProperty(win, atom)) {
+      return;
+   }
+
+   np = Allocate(sizeof(PropertyNode));
+   np->window = win;
+   np->atom = atom;
+   np->cookie = xcb_get_property(XGetXCBConnection(display), 0, win, atom,
+                                 XCB_GET_PROPERTY_TYPE_ANY, 0, length);
+   np->reply = NULL;
+   np->status = Success;
+   np->pending = 1;
+   np->next = properties[index];
+   properties[index] = np;
+}
+
+/** Wait for the reply to a prefetched property. */
+void CollectProperty(PropertyNode *np)
+{
+   xcb_generic_error_t *error = NULL;
+   np->reply = xcb_get_property_reply(XGetXCBConnection(display),
+                                      np->cookie, &error);
+   np->pending = 0;
+   if(error) {
+      np->status = error->error_code;
+      free(error);
+   } else if(!np->reply) {
+      np->status = BadImplementation;
+   }
+}
+
+/** Copy a prefetched property in the format XGetWindowProperty uses.
+ * Returns 0 if the requested range was not prefetched.
+ */
+char CopyProperty(const PropertyNode *np,
+                  long offset, long length, Atom reqType,
+                  Atom *actualType, int *actualFormat,
+                  unsigned long *itemCount, unsigned long *bytesLeft,
+                  unsigned char **data)
+{
+   const xcb_get_property_reply_t *reply = np->reply;
+   const unsigned char *value;
+   unsigned long have, total, start, size, count, i;
+   unsigned int unit;
+
+   if(reply->type == None) {
+      *actualType = None;
+      *actualFormat = 0;
+      *itemCount = 0;
+      *bytesLeft = 0;
+      *data = NULL;
+      return 1;
+   }
+
+   have = xcb_get_property_value_length(reply);
+   total = have + reply->bytes_after;
+   if(reqType != AnyPropertyType && reqType != reply->type) {
+      /* The server reports the type and size without any data. */
+      *actualType = reply->type;
+      *actualFormat = reply->format;
+      *itemCount = 0;
+      *bytesLeft = total;
+      *data = malloc(1);
+      (*data)[0] = 0;
+      return 1;
+   }
+
+   start = 4 * (unsigned long)offset;
+   if(start > total) {
+      return 0;
+   }
+   size = Min(total - start, 4 * (unsigned long)length);
+   if(start + size > have) {
+      return 0;
+   }
+
+   unit = reply->format / 8;
+   count = size / unit;
+   value = (const unsigned char*)xcb_get_property_value(reply) + start;
+   *actualType = reply->type;
+   *actualFormat = reply->format;
+   *itemCount = count;
+   *bytesLeft = total - start - size;
+   switch(reply->format) {
+   case 32:
+      /* Xlib returns 32-bit items as sign-extended longs. */
+      *data = malloc(count * sizeof(long) + 1);
+      for(i = 0; i < count; i++) {
+         int32_t item;
+         memcpy(&item, &value[i * 4], 4);
+         ((long*)*data)[i] = item;
+      }
+      break;
+   case 16:
+      *data = malloc(count * sizeof(short) + 1);
+      for(i = 0; i < count; i++) {
+         int16_t item;
+         memcpy(&item, &value[i * 2], 2);
+         ((short*)*data)[i] = item;
+      }
+      break;
+   default:
+      *data = malloc(count + 1);
+      memcpy(*data, value, count);
+      (*data)[count] = 0;
+      break;
+   }
+   return 1;
+}
+
+/** Read a window property, using a prefetched reply if possible. */
+int GetPrefetchedProperty(Display *d, Window win, Atom atom,
+                          long offset, long length, Bool del, Atom reqType,
+                          Atom *actualType, int *actualFormat,
+                          unsigned long *itemCount, unsigned long *bytesLeft,
+                          unsigned char **data)
+{
+   PropertyNode *np = FindProperty(win, atom);
+   if(np && !del) {
+      if(np->pending) {
+         CollectProperty(np);
+      }
+      if(np->status != Success) {
+         return np->status;
+      }
+      if(CopyProperty(np, offset, length, reqType, actualType, actualFormat,
+                      itemCount, bytesLeft, data)) {
+         return Success;
+      }
+   }
+   return XGetWindowProperty(d, win, atom, offset, length, del, reqType,
+                             actualType, actualFormat, itemCount, bytesLeft,
+                             data);
+}
+
+/** Release a prefetched property. */
+void ReleaseProperty(PropertyNode *np)
+{
+   if(np->pending) {
+      xcb_discard_reply(XGetXCBConnection(display), np->cookie.sequence);
+   } else if(np->reply) {
+      free(np->reply);
+   }
+   Release(np);
+}
+
+/** Find prefetched window attributes. */
+AttributeNode *FindAttributes(Window win)
+{
+   AttributeNode *ap = attributes[win % PROPERTY_HASH_SIZE];
+   while(ap) {
+      if(ap->window == win) {
+         return ap;
+      }
+      ap = ap->next;
+   }
+   return NULL;
+}
+
+/** Request the attributes of a window without waiting for the reply. */
+void PrefetchWindowAttributes(Window win)
+{
+   const unsigned int index = win % PROPERTY_HASH_SIZE;
+   xcb_connection_t *c;
+   AttributeNode *ap;
+
+   if(FindAttributes(win)) {
+      return;
+   }
+
+   /* XGetWindowAttributes needs both of these requests. */
+   c = XGetXCBConnection(display);
+   ap = Allocate(sizeof(AttributeNode));
+   ap->window = win;
+   ap->attrCookie = xcb_get_window_attributes(c, win);
+   ap->geomCookie = xcb_get_geometry(c, win);
+   ap->attrReply = NULL;
+   ap->geomReply = NULL;
+   ap->pending = 1;
+   ap->next = attributes[index];
+   attributes[index] = ap;
+}
+
+/** Wait for the replies to prefetched window attributes. */
+void CollectAttributes(AttributeNode *ap)
+{
+   xcb_connection_t *c = XGetXCBConnection(display);
+   xcb_generic_error_t *error = NULL;
+   ap->attrReply = xcb_get_window_attributes_reply(c, ap->attrCookie, &error);
+   if(error) {
+      free(error);
+      error = NULL;
+   }
+   ap->geomReply = xcb_get_geometry_reply(c, ap->geomCookie, &error);
+   if(error) {
+      free(error);
+   }
+   ap->pending = 0;
+}
+
+/** Look up a visual by ID. */
+Visual *FindVisual(Display *d, VisualID id)
+{
+   int s, i, j;
+   for(s = 0; s < ScreenCount(d); s++) {
+      const Screen *sp = ScreenOfDisplay(d, s);
+      for(i = 0; i < sp->ndepths; i++) {
+         const Depth *dp = &sp->depths[i];
+         for(j = 0; j < dp->nvisuals; j++) {
+            if(dp->visuals[j].visualid == id) {
+               return &dp->visuals[j];
+            }
+         }
+      }
+   }
+   return NULL;
+}
+
+/** Get window attributes, using prefetched replies if possible. */
+Status GetPrefetchedWindowAttributes(Display *d, Window win,
+                                     XWindowAttributes *attr)
+{
+   const xcb_get_window_attributes_reply_t *ar;
+   const xcb_get_geometry_reply_t *gr;
+   AttributeNode *ap;
+   int s;
+
+   ap = FindAttributes(win);
+   if(!ap) {
+      return XGetWindowAttributes(d, win, attr);
+   }
+   if(ap->pending) {
+      CollectAttributes(ap);
+   }
+   ar = ap->attrReply;
+   gr = ap->geomReply;
+   if(!ar || !gr) {
+      return 0;
+   }
+
+   /* Fill in the attributes the same way XGetWindowAttributes does. */
+   attr->x                     = gr->x;
+   attr->y                     = gr->y;
+   attr->width                 = gr->width;
+   attr->height                = gr->height;
+   attr->border_width          = gr->border_width;
+   attr->depth                 = gr->depth;
+   attr->root                  = gr->root;
+   attr->visual                = FindVisual(d, ar->visual);
+   attr->class                 = ar->_class;
+   attr->bit_gravity           = ar->bit_gravity;
+   attr->win_gravity           = ar->win_gravity;
+   attr->backing_store         = ar->backing_store;
+   attr->backing_planes        = ar->backing_planes;
+   attr->backing_pixel         = ar->backing_pixel;
+   attr->save_under            = ar->save_under;
+   attr->colormap              = ar->colormap;
+   attr->map_installed         = ar->map_is_installed;
+   attr->map_state             = ar->map_state;
+   attr->all_event_masks       = ar->all_event_masks;
+   attr->your_event_mask       = ar->your_event_mask;
+   attr->do_not_propagate_mask = ar->do_not_propagate_mask;
+   attr->override_redirect     = ar->override_redirect;
+   attr->screen                = NULL;
+   for(s = 0; s < ScreenCount(d); s++) {
+      if(RootWindow(d, s) == gr->root) {
+         attr->screen = ScreenOfDisplay(d, s);
+         break;
+      }
+   }
+   return 1;
+}
+
+/** Release prefetched window attributes. */
+void ReleaseAttributes(AttributeNode *ap)
+{
+   if(ap->pending) {
+      xcb_connection_t *c = XGetXCBConnection(display);
+      xcb_discard_reply(c, ap->attrCookie.sequence);
+      xcb_discard_reply(c, ap->geomCookie.sequence);
+   } else {
+      if(ap->attrReply) {
+         free(ap->attrReply);
+      }
+      if(ap->geomReply) {
+         free(ap->geomReply);
+      }
+   }
+   Release(ap);
+}
+
+/** Discard prefetched requests for a window. */
+void ReleasePrefetchedWindow(Window win)
+{
+   AttributeNode **ap;
+   unsigned int x;
+   for(x = 0; x < PROPERTY_HASH_SIZE; x++) {
+      PropertyNode **np = &properties[x];
+      while(*np) {
+         if((*np)->window == win) {
+            PropertyNode *temp = *np;
+            *np = temp->next;
+            ReleaseProperty(temp);
+         } else {
+            np = &(*np)->next;
+         }
+      }
+   }
+   ap = &attributes[win % PROPERTY_HASH_SIZE];
+   while(*ap) {
+      if((*ap)->window == win) {
+         AttributeNode *temp = *ap;
+         *ap = temp->next;
+         ReleaseAttributes(temp);
+      } else {
+         ap = &(*ap)->next;
+      }
+   }
+}
+
+#endif /* USE_XCB */
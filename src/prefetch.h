@@ -0,0 +1,61 @@
+/**
+ * @file prefetch.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Header for pipelined property and attribute requests.
+ *
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#ifdef USE_XCB
+
+/** Request a window property without waiting for the reply.
+ * The reply is collected the first time the property is read with
+ * JXGetWindowProperty. This allows the requests for many properties
+ * (and many windows) to be sent at once so that the replies arrive
+ * together.
+ * Note that reads return the property as it was when requested.
+ * @param win The window.
+ * @param atom The property to request.
+ * @param length The maximum length to request (in 32-bit units).
+ */
+void PrefetchProperty(Window win, Atom atom, long length);
+
+/** Request the attributes of a window without waiting for the reply.
+ * The reply is collected by JXGetWindowAttributes.
+ * @param win The window.
+ */
+void PrefetchWindowAttributes(Window win);
+
+/** Discard prefetched requests for a window.
+ * @param win The window.
+ */
+void ReleasePrefetchedWindow(Window win);
+
+/** Read a window property, using a prefetched reply if possible.
+ * This has the same interface as XGetWindowProperty.
+ */
+int GetPrefetchedProperty(Display *d, Window win, Atom atom,
+                          long offset, long length, Bool del, Atom reqType,
+                          Atom *actualType, int *actualFormat,
+                          unsigned long *itemCount, unsigned long *bytesLeft,
+                          unsigned char **data);
+
+/** Get window attributes, using prefetched replies if possible.
+ * This has the same interface as XGetWindowAttributes.
+ */
+Status GetPrefetchedWindowAttributes(Display *d, Window win,
+                                     XWindowAttributes *attr);
+
+#else
+
+#  define PrefetchProperty( w, a, l )    ((void)0)
+#  define PrefetchWindowAttributes( w )  ((void)0)
+#  define ReleasePrefetchedWindow( w )   ((void)0)
+
+#endif /* USE_XCB */
+
+#endif /* PREFETCH_H */
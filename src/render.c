@@ -14,6 +14,7 @@
 #include "main.h"
 #include "color.h"
 #include "misc.h"
+#include "upload.h"
 
 /** Draw a scaled icon. */
 void PutScaledRenderIcon(const IconNode *icon,
@@ -90,7 +91,6 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
 #ifdef USE_XRENDER
 
    XRenderPictFormat *fp;
-   XColor color;
    GC maskGC;
    XImage *destImage;
    XImage *destMask;
@@ -112,13 +112,8 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    maskGC = JXCreateGC(display, mask, 0, NULL);
    pmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
 
-   destImage = JXCreateImage(display, rootVisual, rootDepth,
-                             ZPixmap, 0, NULL, width, height, 8, 0);
-   destImage->data = Allocate(sizeof(unsigned long) * width * height);
-
-   destMask = JXCreateImage(display, rootVisual, 8, ZPixmap,
-                            0, NULL, width, height, 8, 0);
-   destMask->data = Allocate(width * height);
+   destImage = CreateUploadImage(rootDepth, width, height);
+   destMask = CreateUploadImage(8, width, height);
 
    if(image->bitmap) {
       perLine = (image->width >> 3) + ((image->width & 7) ? 1 : 0);
@@ -128,9 +123,8 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    maskLine = 0;
    for(y = 0; y < height; y++) {
       const int yindex = y * perLine;
-      for(x = 0; x < width; x++) {
-         if(image->bitmap) {
-
+      if(image->bitmap) {
+         for(x = 0; x < width; x++) {
             const int offset = yindex + (x >> 3);
             const int mask = 1 << (x & 7);
             unsigned long alpha = 0;
@@ -139,41 +133,24 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
                XPutPixel(destImage, x, y, fg);
             }
             destMask->data[maskLine + x] = alpha;
-
-         } else {
-
-            const int index = 4 * (yindex + x);
-            const unsigned long alpha = image->data[index];
-            color.red = image->data[index + 1];
-            color.red |= color.red << 8;
-            color.green = image->data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = image->data[index + 3];
-            color.blue |= color.blue << 8;
-
-            color.red = (color.red * alpha) >> 8;
-            color.green = (color.green * alpha) >> 8;
-            color.blue = (color.blue * alpha) >> 8;
-
-            GetColor(&color);
-            XPutPixel(destImage, x, y, color.pixel);
-            destMask->data[maskLine + x] = alpha;
+         }
+      } else {
+         const unsigned char *row = &image->data[4 * yindex];
+         PutColorRow(destImage, y, row, width, 1);
+         for(x = 0; x < width; x++) {
+            destMask->data[maskLine + x] = row[4 * x];
          }
       }
       maskLine += destMask->bytes_per_line;
    }
 
    /* Render the image data to the image pixmap. */
-   JXPutImage(display, pmap, rootGC, destImage, 0, 0, 0, 0, width, height);
-   Release(destImage->data);
-   destImage->data = NULL;
-   JXDestroyImage(destImage);
+   PutUploadImage(pmap, rootGC, destImage, width, height);
+   DestroyUploadImage(destImage);
 
    /* Render the alpha data to the mask pixmap. */
-   JXPutImage(display, mask, maskGC, destMask, 0, 0, 0, 0, width, height);
-   Release(destMask->data);
-   destMask->data = NULL;
-   JXDestroyImage(destMask);
+   PutUploadImage(mask, maskGC, destMask, width, height);
+   DestroyUploadImage(destMask);
    JXFreeGC(display, maskGC);
 
    /* Create the alpha picture. */
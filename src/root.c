@@ -62,6 +62,17 @@ void StartupRootMenu(void)
 
 }
 
+/** Request that root menu icons be decoded ahead of time. */
+void PreloadRootMenu(void)
+{
+   unsigned int x;
+   for(x = 0; x < ROOT_MENU_COUNT; x++) {
+      if(rootMenu[x]) {
+         PreloadMenu(rootMenu[x]);
+      }
+   }
+}
+
 /** Destroy root menu data. */
 void DestroyRootMenu(void)
 {
@@ -19,6 +19,9 @@ void StartupRootMenu(void);
 void DestroyRootMenu(void);
 /*@}*/
 
+/** Request that root menu icons be decoded ahead of time. */
+void PreloadRootMenu(void);
+
 /** Set the root menu to be used for the specified indexes.
  * @param indexes The indexes (ASCII string of '0' to '9').
  * @param m The menu to use for the specified indexes.
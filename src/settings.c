@@ -64,6 +64,7 @@ void InitializeSettings(void)
    settings.groupTasks = 0;
    settings.listAllTasks = 0;
    settings.dockSpacing = 0;
+   settings.fontCacheSize = 256;
    settings.showClientName = 0;
    memcpy(settings.clientNameDelimiters, DEFAULT_CLIENT_NAME_DELIMITERS,
       sizeof(settings.clientNameDelimiters));
@@ -93,6 +94,7 @@ void StartupSettings(void)
    }
 
    FixRange(&settings.dockSpacing, 0, 64, 0);
+   FixRange(&settings.fontCacheSize, 0, 65536, 256);
 }
 
 /** Update a string setting. */
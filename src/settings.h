@@ -108,6 +108,7 @@ typedef struct {
    unsigned cornerRadius;
    unsigned moveMask;
    unsigned dockSpacing;
+   unsigned fontCacheSize;
    AlignmentType titleTextAlignment;
    SnapModeType snapMode;
    MoveModeType moveMode;
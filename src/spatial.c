@@ -0,0 +1,407 @@
+/**
+ * @file spatial.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Spatial index of client frames.
+ *
+ * Clients are stored in a uniform grid of cells for each desktop (with
+ * an extra grid for sticky clients). A client is listed in every cell
+ * its frame covers so that a query only needs to look at the cells
+ * covering the query rectangle. Each grid also keeps a list of its
+ * clients so that the clients on a desktop can be found directly.
+ *
+ */
+
+#include "jwm.h"
+#include "spatial.h"
+#include "border.h"
+#include "client.h"
+#include "clientlist.h"
+#include "main.h"
+#include "misc.h"
+#include "settings.h"
+
+/** Size of a grid cell in pixels. */
+#define CELL_SIZE 256
+
+/** Index data for a client. */
+typedef struct SpatialEntry {
+   struct ClientNode *client;
+   int grid;                  /**< Grid containing the client, -1 if none. */
+   int left, top;             /**< First cell covered. */
+   int right, bottom;         /**< Last cell covered. */
+   unsigned int stamp;        /**< Last query to return this client. */
+   unsigned int order;        /**< Position in the stacking order. */
+   int list;                  /**< Grid list containing the client. */
+   struct SpatialEntry *prev; /**< Previous client in the grid list. */
+   struct SpatialEntry *next; /**< Next client in the grid list. */
+} SpatialEntry;
+
+/** Clients listed in a grid cell. */
+typedef struct SpatialCell {
+   SpatialEntry **entries;
+   unsigned int count;
+   unsigned int size;
+} SpatialCell;
+
+static SpatialCell *cells = NULL;
+static SpatialEntry **lists = NULL;
+static int gridCount;
+static int gridWidth;
+static int gridHeight;
+
+static ClientNode **results = NULL;
+static unsigned int resultSize;
+static unsigned int queryStamp;
+static char orderDirty;
+
+static SpatialCell *GetCell(int grid, int x, int y);
+static int GetCellX(int x);
+static int GetCellY(int y);
+static void AddEntry(SpatialEntry *ep);
+static void RemoveEntry(SpatialEntry *ep);
+static void LinkEntry(SpatialEntry *ep, int grid);
+static void UnlinkEntry(SpatialEntry *ep);
+static void UpdateStackOrder(void);
+static void ResetStamps(void);
+static void CollectCells(int grid, int left, int top, int right, int bottom,
+                         unsigned int *count);
+static int BottomFirstComparator(const void *a, const void *b);
+static int TopFirstComparator(const void *a, const void *b);
+
+/** Startup the spatial index. */
+void StartupSpatial(void)
+{
+   unsigned int total;
+   gridWidth = (rootWidth + CELL_SIZE - 1) / CELL_SIZE;
+   gridHeight = (rootHeight + CELL_SIZE - 1) / CELL_SIZE;
+   gridWidth = Max(gridWidth, 1);
+   gridHeight = Max(gridHeight, 1);
+
+   /* One grid per desktop plus a grid for sticky clients. */
+   gridCount = settings.desktopCount + 1;
+   total = gridCount * gridWidth * gridHeight;
+   cells = Allocate(total * sizeof(SpatialCell));
+   memset(cells, 0, total * sizeof(SpatialCell));
+   lists = Allocate(gridCount * sizeof(SpatialEntry*));
+   memset(lists, 0, gridCount * sizeof(SpatialEntry*));
+
+   results = NULL;
+   resultSize = 0;
+   queryStamp = 0;
+   orderDirty = 1;
+}
+
+/** Shutdown the spatial index. */
+void ShutdownSpatial(void)
+{
+   const unsigned int total = gridCount * gridWidth * gridHeight;
+   unsigned int i;
+   for(i = 0; i < total; i++) {
+      if(cells[i].entries) {
+         Release(cells[i].entries);
+      }
+   }
+   Release(cells);
+   cells = NULL;
+   Release(lists);
+   lists = NULL;
+   if(results) {
+      Release(results);
+      results = NULL;
+   }
+}
+
+/** Get a grid cell. */
+SpatialCell *GetCell(int grid, int x, int y)
+{
+   return &cells[(grid * gridHeight + y) * gridWidth + x];
+}
+
+/** Get the cell column containing an x-coordinate. */
+int GetCellX(int x)
+{
+   if(x < 0) {
+      return 0;
+   }
+   return Min(x / CELL_SIZE, gridWidth - 1);
+}
+
+/** Get the cell row containing a y-coordinate. */
+int GetCellY(int y)
+{
+   if(y < 0) {
+      return 0;
+   }
+   return Min(y / CELL_SIZE, gridHeight - 1);
+}
+
+/** Add an entry to the cells it covers. */
+void AddEntry(SpatialEntry *ep)
+{
+   int x, y;
+   for(y = ep->top; y <= ep->bottom; y++) {
+      for(x = ep->left; x <= ep->right; x++) {
+         SpatialCell *cp = GetCell(ep->grid, x, y);
+         if(cp->count == cp->size) {
+            cp->size = cp->size ? cp->size * 2 : 4;
+            cp->entries = Reallocate(cp->entries,
+                                     cp->size * sizeof(SpatialEntry*));
+         }
+         cp->entries[cp->count] = ep;
+         cp->count += 1;
+      }
+   }
+}
+
+/** Remove an entry from the cells it covers. */
+void RemoveEntry(SpatialEntry *ep)
+{
+   int x, y;
+   if(ep->grid < 0) {
+      return;
+   }
+   for(y = ep->top; y <= ep->bottom; y++) {
+      for(x = ep->left; x <= ep->right; x++) {
+         SpatialCell *cp = GetCell(ep->grid, x, y);
+         unsigned int i;
+         for(i = 0; i < cp->count; i++) {
+            if(cp->entries[i] == ep) {
+               cp->count -= 1;
+               cp->entries[i] = cp->entries[cp->count];
+               break;
+            }
+         }
+      }
+   }
+   ep->grid = -1;
+}
+
+/** Add an entry to the client list of a grid. */
+void LinkEntry(SpatialEntry *ep, int grid)
+{
+   ep->list = grid;
+   ep->prev = NULL;
+   ep->next = lists[grid];
+   if(ep->next) {
+      ep->next->prev = ep;
+   }
+   lists[grid] = ep;
+}
+
+/** Remove an entry from the client list of its grid. */
+void UnlinkEntry(SpatialEntry *ep)
+{
+   if(ep->list < 0) {
+      return;
+   }
+   if(ep->prev) {
+      ep->prev->next = ep->next;
+   } else {
+      lists[ep->list] = ep->next;
+   }
+   if(ep->next) {
+      ep->next->prev = ep->prev;
+   }
+   ep->list = -1;
+}
+
+/** Add a client to the spatial index. */
+void InsertClientIndex(ClientNode *np)
+{
+   SpatialEntry *ep = Allocate(sizeof(SpatialEntry));
+   ep->client = np;
+   ep->grid = -1;
+   ep->list = -1;
+   ep->stamp = queryStamp;
+   ep->order = 0;
+   np->spatial = ep;
+   orderDirty = 1;
+   UpdateClientIndex(np);
+}
+
+/** Update the location of a client in the spatial index. */
+void UpdateClientIndex(const ClientNode *np)
+{
+   SpatialEntry *ep = np->spatial;
+   int north, south, east, west;
+   int grid, left, top, right, bottom;
+
+   if(!ep) {
+      return;
+   }
+
+   if((np->state.status & STAT_STICKY)
+      || np->state.desktop >= settings.desktopCount) {
+      grid = gridCount - 1;
+   } else {
+      grid = np->state.desktop;
+   }
+   if(grid != ep->list) {
+      UnlinkEntry(ep);
+      LinkEntry(ep, grid);
+   }
+
+   /* Index the unshaded frame so that the entry covers both the
+    * frame and the client area regardless of the shade state. */
+   GetBorderSize(&np->state, &north, &south, &east, &west);
+   left = GetCellX(np->x - west);
+   right = GetCellX(np->x + np->width + east);
+   top = GetCellY(np->y - north);
+   bottom = GetCellY(np->y + np->height + south);
+
+   if(grid == ep->grid && left == ep->left && right == ep->right
+      && top == ep->top && bottom == ep->bottom) {
+      return;
+   }
+
+   RemoveEntry(ep);
+   ep->grid = grid;
+   ep->left = left;
+   ep->right = right;
+   ep->top = top;
+   ep->bottom = bottom;
+   AddEntry(ep);
+}
+
+/** Remove a client from the spatial index. */
+void RemoveClientIndex(ClientNode *np)
+{
+   if(np->spatial) {
+      RemoveEntry(np->spatial);
+      UnlinkEntry(np->spatial);
+      Release(np->spatial);
+      np->spatial = NULL;
+   }
+}
+
+/** Note that the stacking order of clients has changed. */
+void InvalidateStackOrder(void)
+{
+   orderDirty = 1;
+}
+
+/** Number the clients from the bottom of the stack to the top. */
+void UpdateStackOrder(void)
+{
+   unsigned int order = 0;
+   int layer;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      ClientNode *np;
+      for(np = nodeTail[layer]; np; np = np->prev) {
+         if(np->spatial) {
+            np->spatial->order = order;
+            order += 1;
+         }
+      }
+   }
+   orderDirty = 0;
+}
+
+/** Clear query stamps when the stamp counter wraps. */
+void ResetStamps(void)
+{
+   int layer;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      ClientNode *np;
+      for(np = nodes[layer]; np; np = np->next) {
+         if(np->spatial) {
+            np->spatial->stamp = 0;
+         }
+      }
+   }
+   queryStamp = 1;
+}
+
+/** Add the clients in a range of cells to the results. */
+void CollectCells(int grid, int left, int top, int right, int bottom,
+                  unsigned int *count)
+{
+   int x, y;
+   for(y = top; y <= bottom; y++) {
+      for(x = left; x <= right; x++) {
+         const SpatialCell *cp = GetCell(grid, x, y);
+         unsigned int i;
+         for(i = 0; i < cp->count; i++) {
+            SpatialEntry *ep = cp->entries[i];
+            if(ep->stamp == queryStamp) {
+               continue;
+            }
+            ep->stamp = queryStamp;
+            if(*count == resultSize) {
+               resultSize = resultSize ? resultSize * 2 : 16;
+               results = Reallocate(results,
+                                    resultSize * sizeof(ClientNode*));
+            }
+            results[*count] = ep->client;
+            *count += 1;
+         }
+      }
+   }
+}
+
+/** Compare clients from the bottom of the stack to the top. */
+int BottomFirstComparator(const void *a, const void *b)
+{
+   const unsigned int ia = (*(ClientNode* const*)a)->spatial->order;
+   const unsigned int ib = (*(ClientNode* const*)b)->spatial->order;
+   return (ia > ib) - (ia < ib);
+}
+
+/** Compare clients from the top of the stack to the bottom. */
+int TopFirstComparator(const void *a, const void *b)
+{
+   return BottomFirstComparator(b, a);
+}
+
+/** Get the clients that may intersect a rectangle. */
+ClientNode **GetClientsInRect(int desktop, int x, int y,
+                              int width, int height,
+                              char topFirst, unsigned int *count)
+{
+   const int left = GetCellX(x);
+   const int right = GetCellX(x + width);
+   const int top = GetCellY(y);
+   const int bottom = GetCellY(y + height);
+
+   *count = 0;
+   queryStamp += 1;
+   if(JUNLIKELY(queryStamp == 0)) {
+      ResetStamps();
+   }
+
+   if(desktop >= 0 && desktop < gridCount - 1) {
+      CollectCells(desktop, left, top, right, bottom, count);
+   }
+   CollectCells(gridCount - 1, left, top, right, bottom, count);
+
+   if(*count > 1) {
+      if(orderDirty) {
+         UpdateStackOrder();
+      }
+      qsort(results, *count, sizeof(ClientNode*),
+            topFirst ? TopFirstComparator : BottomFirstComparator);
+   }
+   return results;
+}
+
+/** Get the clients on a desktop. */
+ClientNode **GetDesktopClients(int desktop, unsigned int *count)
+{
+   const SpatialEntry *ep;
+
+   *count = 0;
+   if(desktop < 0 || desktop >= gridCount - 1) {
+      return results;
+   }
+   for(ep = lists[desktop]; ep; ep = ep->next) {
+      if(*count == resultSize) {
+         resultSize = resultSize ? resultSize * 2 : 16;
+         results = Reallocate(results, resultSize * sizeof(ClientNode*));
+      }
+      results[*count] = ep->client;
+      *count += 1;
+   }
+   return results;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file spatial.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Header for the spatial index of client frames.
+ *
+ */
+
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+struct ClientNode;
+
+/*@{*/
+#define InitializeSpatial()   (void)(0)
+void StartupSpatial(void);
+void ShutdownSpatial(void);
+#define DestroySpatial()      (void)(0)
+/*@}*/
+
+/** Add a client to the spatial index.
+ * @param np The client to add.
+ */
+void InsertClientIndex(struct ClientNode *np);
+
+/** Update the location of a client in the spatial index.
+ * This should be called when the position, size, border, or desktop
+ * of a client changes. It does nothing if the client was not inserted.
+ * @param np The client.
+ */
+void UpdateClientIndex(const struct ClientNode *np);
+
+/** Remove a client from the spatial index.
+ * @param np The client to remove.
+ */
+void RemoveClientIndex(struct ClientNode *np);
+
+/** Note that the stacking order of clients has changed. */
+void InvalidateStackOrder(void);
+
+/** Get the clients that may intersect a rectangle.
+ * The result includes clients on the specified desktop and sticky clients
+ * whose frame could touch the rectangle (edges inclusive). Callers must
+ * still perform their own exact tests. The array is valid until the
+ * next call.
+ * @param desktop The desktop.
+ * @param x The left edge of the rectangle.
+ * @param y The top edge of the rectangle.
+ * @param width The width of the rectangle.
+ * @param height The height of the rectangle.
+ * @param topFirst 1 to sort from top to bottom, 0 for bottom to top.
+ * @param count Location to store the number of clients returned.
+ * @return The clients sorted by stacking order.
+ */
+struct ClientNode **GetClientsInRect(int desktop, int x, int y,
+                                     int width, int height,
+                                     char topFirst, unsigned int *count);
+
+/** Get the clients assigned to a desktop.
+ * Sticky clients are not included. The array is valid until the next
+ * call to GetDesktopClients or GetClientsInRect.
+ * @param desktop The desktop.
+ * @param count Location to store the number of clients returned.
+ * @return The clients (in no particular order).
+ */
+struct ClientNode **GetDesktopClients(int desktop, unsigned int *count);
+
+#endif /* SPATIAL_H */
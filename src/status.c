@@ -155,6 +155,7 @@ void DestroyMoveResizeWindow(void)
       statusWindow = None;
    }
    if(statusPixmap != None) {
+      ReleaseStringContext(statusPixmap);
       JXFreePixmap(display, statusPixmap);
       statusPixmap = None;
    }
@@ -44,27 +44,47 @@ typedef struct TaskBarType {
 
    TimeType mouseTime;
    int mousex, mousey;
+   char hover;          /**< Set while the popup callback is registered. */
 
 } TaskBarType;
 
 typedef struct ClientEntry {
    ClientNode *client;
+   struct TaskEntry *task;       /**< The entry containing this client. */
    struct ClientEntry *next;
    struct ClientEntry *prev;
 } ClientEntry;
 
 typedef struct TaskEntry {
    ClientEntry *clients;
+   unsigned int hash;            /**< Hash of the class name (grouped). */
+   char grouped;                 /**< Set if in the class name hash. */
    struct TaskEntry *next;
    struct TaskEntry *prev;
+   struct TaskEntry *hashNext;   /**< Next entry in the hash bucket. */
 } TaskEntry;
 
+/** Size of the class name hash for grouped tasks. */
+#define TASK_HASH_SIZE 64
+
+/** A window list as last written to a root window property. */
+typedef struct WindowList {
+   Window *windows;
+   unsigned int count;
+   unsigned int size;
+   char valid;                   /**< Set once the property is written. */
+} WindowList;
+
 static TaskBarType *bars;
 static TaskEntry *taskEntries;
 static TaskEntry *taskEntriesTail;
+static TaskEntry *taskHash[TASK_HASH_SIZE];
+static WindowList clientList;
+static WindowList stackingList;
 
 static unsigned TallyVisibleItems(void);
 static void ComputeItemSize(TaskBarType *tp);
+static int GetItemHeightLimit(const TaskBarType *tp);
 static char ShouldShowEntry(const TaskEntry *tp);
 static char ShouldFocusEntry(const TaskEntry *tp);
 static TaskEntry *GetEntry(TaskBarType *bar, int x, int y);
@@ -82,6 +102,11 @@ static void FocusGroup(const TaskEntry *tp);
 static char IsGroupOnTop(const TaskEntry *entry);
 static void ProcessTaskMotionEvent(TrayComponentType *cp,
                                    int x, int y, int mask);
+static unsigned int GetTaskHash(const char *str);
+static TaskEntry *FindTaskEntry(const char *className, unsigned int hash);
+static void PublishWindowList(WindowList *lp, AtomType atom,
+                              const Window *windows, unsigned int count);
+static void ReleaseWindowList(WindowList *lp);
 static void SignalTaskbar(const TimeType *now, int x, int y, Window w,
                           void *data);
 
@@ -91,6 +116,9 @@ void InitializeTaskBar(void)
    bars = NULL;
    taskEntries = NULL;
    taskEntriesTail = NULL;
+   memset(taskHash, 0, sizeof(taskHash));
+   memset(&clientList, 0, sizeof(clientList));
+   memset(&stackingList, 0, sizeof(stackingList));
 }
 
 /** Shutdown the task bar. */
@@ -98,8 +126,11 @@ void ShutdownTaskBar(void)
 {
    TaskBarType *bp;
    for(bp = bars; bp; bp = bp->next) {
+      ReleaseStringContext(bp->buffer);
       JXFreePixmap(display, bp->buffer);
    }
+   ReleaseWindowList(&clientList);
+   ReleaseWindowList(&stackingList);
 }
 
 /** Destroy task bar data. */
@@ -108,7 +139,9 @@ void DestroyTaskBar(void)
    TaskBarType *bp;
    while(bars) {
       bp = bars->next;
-      UnregisterCallback(SignalTaskbar, bars);
+      if(bars->hover) {
+         UnregisterCallback(SignalTaskbar, bars);
+      }
       Release(bars);
       bars = bp;
    }
@@ -135,6 +168,7 @@ TrayComponentType *CreateTaskBar()
    tp->mousey = -settings.doubleClickDelta;
    tp->mouseTime.seconds = 0;
    tp->mouseTime.ms = 0;
+   tp->hover = 0;
 
    cp = CreateTrayComponent();
    cp->object = tp;
@@ -146,8 +180,6 @@ TrayComponentType *CreateTaskBar()
    cp->ProcessButtonPress = ProcessTaskButtonEvent;
    cp->ProcessMotionEvent = ProcessTaskMotionEvent;
 
-   RegisterCallback(settings.popupDelay / 2, SignalTaskbar, tp);
-
    return cp;
 
 }
@@ -182,6 +214,7 @@ void Resize(TrayComponentType *cp)
 {
    TaskBarType *tp = (TaskBarType*)cp->object;
    if(tp->buffer != None) {
+      ReleaseStringContext(tp->buffer);
       JXFreePixmap(display, tp->buffer);
    }
    cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
@@ -203,6 +236,31 @@ unsigned TallyVisibleItems(void)
    return count;
 }
 
+/** Determine the largest height of an item in the task bar.
+ * This does not depend on the number of items.
+ */
+int GetItemHeightLimit(const TaskBarType *tp)
+{
+   const TrayComponentType *cp = tp->cp;
+   int height;
+
+   if(tp->layout != LAYOUT_VERTICAL) {
+      return cp->height;
+   }
+   if(tp->labelPos <= LABEL_POSITION_RIGHT) {
+      return tp->userHeight > 0 ? tp->userHeight : GetStringHeight(FONT_TASKLIST) + 12;
+   }
+
+   height = cp->width;
+   if(tp->labeled) {
+      height += GetStringHeight(FONT_TASKLIST);
+   }
+   if(tp->maxItemWidth > 0) {
+      height = Min(tp->maxItemWidth, height);
+   }
+   return height;
+}
+
 /** Determine the size of items in the task bar. */
 void ComputeItemSize(TaskBarType *tp)
 {
@@ -217,18 +275,9 @@ void ComputeItemSize(TaskBarType *tp)
 
          tp->itemWidth = cp->width;
          tp->itemHeight = Max(1, cp->height / itemCount);
-
-         if(!tp->labeled) {
-            tp->itemHeight = Min(tp->itemWidth, tp->itemHeight);
-         } else {
-            tp->itemHeight = Min(tp->itemWidth + GetStringHeight(FONT_TASKLIST), tp->itemHeight);
-         }
-
-         if(tp->maxItemWidth > 0) {
-            tp->itemHeight = Min(tp->maxItemWidth, tp->itemHeight);
-         }
+         tp->itemHeight = Min(GetItemHeightLimit(tp), tp->itemHeight);
       } else {
-         tp->itemHeight = tp->userHeight > 0 ? tp->userHeight : GetStringHeight(FONT_TASKLIST) + 12;
+         tp->itemHeight = GetItemHeightLimit(tp);
          tp->itemWidth = cp->width;
       }
    } else {
@@ -237,7 +286,7 @@ void ComputeItemSize(TaskBarType *tp)
          return;
       }
 
-      tp->itemHeight = cp->height;
+      tp->itemHeight = GetItemHeightLimit(tp);
       tp->itemWidth = Max(1, cp->width / itemCount);
 
       if(!tp->labeled) {
@@ -496,6 +545,12 @@ void ProcessTaskMotionEvent(TrayComponentType *cp, int x, int y, int mask)
    bp->mousex = cp->screenx + x;
    bp->mousey = cp->screeny + y;
    GetCurrentTime(&bp->mouseTime);
+
+   /* Watch for popups while the mouse is over the task bar. */
+   if(!bp->hover) {
+      bp->hover = 1;
+      RegisterCallback(settings.popupDelay / 2, SignalTaskbar, bp);
+   }
 }
 
 /** Show the menu associated with a task list item. */
@@ -653,24 +708,56 @@ void RunTaskBarCommand(MenuAction *action, unsigned button)
    }
 }
 
+/** Get the hash for a class name. */
+unsigned int GetTaskHash(const char *str)
+{
+   unsigned int hash = 0;
+   unsigned int x;
+   for(x = 0; str[x]; x++) {
+      hash = (hash + (hash << 5)) ^ (unsigned int)str[x];
+   }
+   return hash;
+}
+
+/** Find the grouped task entry for a class name. */
+TaskEntry *FindTaskEntry(const char *className, unsigned int hash)
+{
+   TaskEntry *tp;
+   for(tp = taskHash[hash & (TASK_HASH_SIZE - 1)]; tp; tp = tp->hashNext) {
+      if(tp->hash == hash
+         && !strcmp(tp->clients->client->className, className)) {
+         return tp;
+      }
+   }
+   return NULL;
+}
+
 /** Add a client to the task bar. */
 void AddClientToTaskBar(ClientNode *np)
 {
    TaskEntry *tp = NULL;
    ClientEntry *cp = Allocate(sizeof(ClientEntry));
+   unsigned int hash = 0;
+   const char grouped = np->className && settings.groupTasks;
    cp->client = np;
+   np->taskEntry = cp;
 
-   if(np->className && settings.groupTasks) {
-      for(tp = taskEntries; tp; tp = tp->next) {
-         const char *className = tp->clients->client->className;
-         if(className && !strcmp(np->className, className)) {
-            break;
-         }
-      }
+   if(grouped) {
+      hash = GetTaskHash(np->className);
+      tp = FindTaskEntry(np->className, hash);
    }
    if(tp == NULL) {
       tp = Allocate(sizeof(TaskEntry));
       tp->clients = NULL;
+      tp->hash = hash;
+      tp->grouped = grouped;
+      if(grouped) {
+         TaskEntry **bucket = &taskHash[hash & (TASK_HASH_SIZE - 1)];
+         tp->hashNext = *bucket;
+         *bucket = tp;
+      } else {
+         tp->hashNext = NULL;
+      }
       tp->next = NULL;
       tp->prev = taskEntriesTail;
       if(taskEntriesTail) {
@@ -686,49 +773,58 @@ void AddClientToTaskBar(ClientNode *np)
       tp->clients->prev = cp;
    }
    cp->prev = NULL;
+   cp->task = tp;
    tp->clients = cp;
 
    RequireTaskUpdate();
-   UpdateNetClientList();
+   RequireClientListUpdate();
 
 }
 
 /** Remove a client from the task bar. */
 void RemoveClientFromTaskBar(ClientNode *np)
 {
+   ClientEntry *cp = np->taskEntry;
    TaskEntry *tp;
-   for(tp = taskEntries; tp; tp = tp->next) {
-      ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
-         if(cp->client == np) {
-            if(cp->prev) {
-               cp->prev->next = cp->next;
-            } else {
-               tp->clients = cp->next;
-            }
-            if(cp->next) {
-               cp->next->prev = cp->prev;
-            }
-            Release(cp);
-            if(!tp->clients) {
-               if(tp->prev) {
-                  tp->prev->next = tp->next;
-               } else {
-                  taskEntries = tp->next;
-               }
-               if(tp->next) {
-                  tp->next->prev = tp->prev;
-               } else {
-                  taskEntriesTail = tp->prev;
-               }
-               Release(tp);
-            }
-            RequireTaskUpdate();
-            UpdateNetClientList();
-            return;
+
+   if(!cp) {
+      return;
+   }
+   np->taskEntry = NULL;
+   tp = cp->task;
+
+   if(cp->prev) {
+      cp->prev->next = cp->next;
+   } else {
+      tp->clients = cp->next;
+   }
+   if(cp->next) {
+      cp->next->prev = cp->prev;
+   }
+   Release(cp);
+
+   if(!tp->clients) {
+      if(tp->grouped) {
+         TaskEntry **lp = &taskHash[tp->hash & (TASK_HASH_SIZE - 1)];
+         while(*lp != tp) {
+            lp = &(*lp)->hashNext;
          }
+         *lp = tp->hashNext;
       }
+      if(tp->prev) {
+         tp->prev->next = tp->next;
+      } else {
+         taskEntries = tp->next;
+      }
+      if(tp->next) {
+         tp->next->prev = tp->prev;
+      } else {
+         taskEntriesTail = tp->prev;
+      }
+      Release(tp);
    }
+   RequireTaskUpdate();
+   RequireClientListUpdate();
 }
 
 /** Update all task bars. */
@@ -773,6 +869,12 @@ void SignalTaskbar(const TimeType *now, int x, int y, Window w, void *data)
    TaskBarType *bp = (TaskBarType*)data;
    TaskEntry *ep;
 
+   if(!IsPointerOnComponent(bp->cp, x, y, w)) {
+      UnregisterCallback(SignalTaskbar, bp);
+      bp->hover = 0;
+      return;
+   }
+
    if(w == bp->cp->tray->window &&
       abs(bp->mousex - x) < settings.doubleClickDelta &&
       abs(bp->mousey - y) < settings.doubleClickDelta) {
@@ -1100,6 +1202,20 @@ void SetTaskBarLabelPosition(TrayComponentType *cp, const char *value)
    }
 }
 
+/** Get the largest size at which task bars draw icons.
+ * This is computed from the tray geometry rather than the current item
+ * size since items are only sized once clients have been added.
+ */
+int GetTaskBarIconSize(void)
+{
+   TaskBarType *bp;
+   int size = 0;
+   for(bp = bars; bp; bp = bp->next) {
+      size = Max(size, GetItemHeightLimit(bp) - BUTTON_BORDER * 2);
+   }
+   return size;
+}
+
 /** Maintain the _NET_CLIENT_LIST[_STACKING] properties on the root. */
 void UpdateNetClientList(void)
 {
@@ -1126,9 +1242,7 @@ void UpdateNetClientList(void)
       }
    }
    Assert(count <= clientCount);
-   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_CLIENT_LIST],
-                    XA_WINDOW, 32, PropModeReplace,
-                    (unsigned char*)windows, count);
+   PublishWindowList(&clientList, ATOM_NET_CLIENT_LIST, windows, count);
 
    /* Set _NET_CLIENT_LIST_STACKING */
    count = 0;
@@ -1138,12 +1252,55 @@ void UpdateNetClientList(void)
          count += 1;
       }
    }
-   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_CLIENT_LIST_STACKING],
-                    XA_WINDOW, 32, PropModeReplace,
-                    (unsigned char*)windows, count);
+   PublishWindowList(&stackingList, ATOM_NET_CLIENT_LIST_STACKING,
+                     windows, count);
 
    if(windows != NULL) {
       ReleaseStack(windows);
    }
    
 }
+
+/** Write a window list to a root window property.
+ * Nothing is written if the list has not changed since it was last
+ * published and windows added to the end are appended, so clients
+ * watching the property only see the changes.
+ */
+void PublishWindowList(WindowList *lp, AtomType atom,
+                       const Window *windows, unsigned int count)
+{
+   if(lp->valid && count >= lp->count && (lp->count == 0
+      || !memcmp(windows, lp->windows, lp->count * sizeof(Window)))) {
+      if(count == lp->count) {
+         return;
+      }
+      JXChangeProperty(display, rootWindow, atoms[atom],
+                       XA_WINDOW, 32, PropModeAppend,
+                       (const unsigned char*)&windows[lp->count],
+                       count - lp->count);
+   } else {
+      JXChangeProperty(display, rootWindow, atoms[atom],
+                       XA_WINDOW, 32, PropModeReplace,
+                       (const unsigned char*)windows, count);
+   }
+
+   /* Remember what was published. */
+   if(count > lp->size) {
+      lp->size = Max(count, lp->size * 2);
+      lp->windows = Reallocate(lp->windows, lp->size * sizeof(Window));
+   }
+   if(count > 0) {
+      memcpy(lp->windows, windows, count * sizeof(Window));
+   }
+   lp->count = count;
+   lp->valid = 1;
+}
+
+/** Forget a published window list. */
+void ReleaseWindowList(WindowList *lp)
+{
+   if(lp->windows) {
+      Release(lp->windows);
+   }
+   memset(lp, 0, sizeof(WindowList));
+}
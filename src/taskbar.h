@@ -36,6 +36,12 @@ void RemoveClientFromTaskBar(struct ClientNode *np);
 /** Update all task bars. */
 void UpdateTaskBar(void);
 
+/** Get the largest size at which task bars draw icons.
+ * This is valid once the trays have been laid out.
+ * @return The icon size in pixels (0 if there are no task bars).
+ */
+int GetTaskBarIconSize(void);
+
 /** Focus the client in the task bar.
  * @param n The window position in the taskbar.
  */
@@ -71,7 +77,10 @@ void SetTaskBarLabeled(struct TrayComponentType *cp, char value);
  */
 void SetTaskBarLabelPosition(struct TrayComponentType *cp, const char *value);
 
-/** Update the _NET_CLIENT_LIST property. */
+/** Update the _NET_CLIENT_LIST property.
+ * Use RequireClientListUpdate to update the property once the current
+ * batch of events has been handled.
+ */
 void UpdateNetClientList(void);
 
 #endif /* TASKBAR_H */
@@ -53,6 +53,26 @@ unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2)
 
 }
 
+/** Compare two normalized times. */
+int CompareTime(const TimeType *t1, const TimeType *t2)
+{
+   if(t1->seconds != t2->seconds) {
+      return t1->seconds < t2->seconds ? -1 : 1;
+   } else if(t1->ms != t2->ms) {
+      return t1->ms < t2->ms ? -1 : 1;
+   } else {
+      return 0;
+   }
+}
+
+/** Advance a time by the specified number of milliseconds. */
+void AddTime(TimeType *t, unsigned long ms)
+{
+   const unsigned long total = t->ms + ms;
+   t->seconds += total / 1000;
+   t->ms = total % 1000;
+}
+
 /** Get the current time. */
 const char *GetTimeString(const char *format, const char *zone)
 {
@@ -34,6 +34,20 @@ void GetCurrentTime(TimeType *t);
  */
 unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2);
 
+/** Compare two times.
+ * Note that the times must be normalized.
+ * @param t1 The first time.
+ * @param t2 The second time.
+ * @return -1 if t1 is earlier, 1 if t1 is later, and 0 if equal.
+ */
+int CompareTime(const TimeType *t1, const TimeType *t2);
+
+/** Advance a time by a number of milliseconds.
+ * @param t The time to update (normalized on return).
+ * @param ms The number of milliseconds to add.
+ */
+void AddTime(TimeType *t, unsigned long ms);
+
 /** Get a time string.
  * Note that the string returned is a static value and should not be
  * deleted. Therefore, this function is not thread safe.
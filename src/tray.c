@@ -285,6 +285,15 @@ TrayComponentType *CreateTrayComponent(void)
    return cp;
 }
 
+/** Determine if the pointer is over a tray component. */
+char IsPointerOnComponent(const TrayComponentType *cp,
+                          int x, int y, Window w)
+{
+   return w == cp->tray->window
+      && x >= cp->screenx && x < cp->screenx + cp->width
+      && y >= cp->screeny && y < cp->screeny + cp->height;
+}
+
 /** Add a tray component to a tray. */
 void AddTrayComponent(TrayType *tp, TrayComponentType *cp)
 {
@@ -832,6 +841,7 @@ void RaiseTrays(void)
       ShowTray(tp);
       JXRaiseWindow(display, tp->window);
    }
+   InvalidateRestack();
 }
 
 /** Lower tray windows. */
@@ -175,6 +175,18 @@ TrayType *CreateTray(void);
  */
 TrayComponentType *CreateTrayComponent(void);
 
+/** Determine if the pointer is over a tray component.
+ * Components use this to stop watching for popups once the pointer
+ * leaves them.
+ * @param cp The tray component.
+ * @param x The x-coordinate of the pointer (root relative).
+ * @param y The y-coordinate of the pointer (root relative).
+ * @param w The window under the pointer.
+ * @return 1 if the pointer is over the component, 0 otherwise.
+ */
+char IsPointerOnComponent(const TrayComponentType *cp,
+                          int x, int y, Window w);
+
 /** Add a tray component to a tray.
  * @param tp The tray to update.
  * @param cp The tray component to add.
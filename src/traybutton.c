@@ -40,6 +40,7 @@ typedef struct TrayButtonType {
    int mousex;
    int mousey;
    TimeType mouseTime;
+   char hover;          /**< Set while the popup callback is registered. */
 
    struct ActionNode *actions;
    struct TrayButtonType *next;
@@ -63,6 +64,15 @@ static void ProcessMotionEvent(TrayComponentType *cp,
 static void SignalTrayButton(const TimeType *now,
                              int x, int y, Window w, void *data);
 
+/** Request that tray button icons be decoded ahead of time. */
+void PreloadTrayButtons(void)
+{
+   TrayButtonType *bp;
+   for(bp = buttons; bp; bp = bp->next) {
+      PreloadNamedIcon(bp->iconName);
+   }
+}
+
 /** Startup tray buttons. */
 void StartupTrayButtons(void)
 {
@@ -100,7 +110,9 @@ void DestroyTrayButtons(void)
    TrayButtonType *bp;
    while(buttons) {
       bp = buttons->next;
-      UnregisterCallback(SignalTrayButton, buttons);
+      if(buttons->hover) {
+         UnregisterCallback(SignalTrayButton, buttons);
+      }
       if(buttons->label) {
          Release(buttons->label);
       }
@@ -151,6 +163,7 @@ TrayComponentType *CreateTrayButton(const char *iconName,
 
    bp->mousex = -settings.doubleClickDelta;
    bp->mousey = -settings.doubleClickDelta;
+   bp->hover = 0;
 
    cp->Create = Create;
    cp->Destroy = Destroy;
@@ -164,8 +177,6 @@ TrayComponentType *CreateTrayButton(const char *iconName,
       cp->ProcessMotionEvent = ProcessMotionEvent;
    }
 
-   RegisterCallback(settings.popupDelay / 2, SignalTrayButton, bp);
-
    return cp;
 
 }
@@ -269,6 +280,7 @@ void Resize(TrayComponentType *cp)
 void Destroy(TrayComponentType *cp)
 {
    if(cp->pixmap != None) {
+      ReleaseStringContext(cp->pixmap);
       JXFreePixmap(display, cp->pixmap);
    }
 }
@@ -323,6 +335,12 @@ void ProcessMotionEvent(TrayComponentType *cp, int x, int y, int mask)
    bp->mousex = cp->screenx + x;
    bp->mousey = cp->screeny + y;
    GetCurrentTime(&bp->mouseTime);
+
+   /* Watch for popups while the mouse is over the button. */
+   if(!bp->hover) {
+      bp->hover = 1;
+      RegisterCallback(settings.popupDelay / 2, SignalTrayButton, bp);
+   }
 }
 
 /** Signal (needed for popups). */
@@ -331,6 +349,12 @@ void SignalTrayButton(const TimeType *now, int x, int y, Window w, void *data)
    TrayButtonType *bp = (TrayButtonType*)data;
    const char *popup;
 
+   if(!IsPointerOnComponent(bp->cp, x, y, w)) {
+      UnregisterCallback(SignalTrayButton, bp);
+      bp->hover = 0;
+      return;
+   }
+
    if(bp->popup) {
       popup = bp->popup;
    } else if(bp->label) {
@@ -20,6 +20,9 @@ void StartupTrayButtons(void);
 void DestroyTrayButtons(void);
 /*@}*/
 
+/** Request that tray button icons be decoded ahead of time. */
+void PreloadTrayButtons(void);
+
 /** Create a tray button component.
  * @param iconName The name of the icon to use for the button.
  * @param label The label to use for the button.
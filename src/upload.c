@@ -0,0 +1,298 @@
+/**
+ * @file upload.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Uploading image data to the X server.
+ *
+ * When the server is local and supports the MIT-SHM extension, image data
+ * is written to a shared memory segment and uploaded with XShmPutImage
+ * instead of being copied through the connection. Small images are packed
+ * into a pool of reusable segments; images larger than a pool segment get
+ * a dedicated segment that is released once the upload completes.
+ *
+ */
+
+#include "jwm.h"
+#include "upload.h"
+#include "main.h"
+#include "misc.h"
+
+#ifdef USE_SHM
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+
+/** Size of a pooled segment. */
+#define SEGMENT_SIZE    (1 << 20)
+
+/** Maximum number of pooled segments. */
+#define SEGMENT_COUNT   4
+
+/** Alignment of images within a segment. */
+#define SEGMENT_ALIGN   16
+
+/** A shared memory segment. */
+typedef struct SegmentNode {
+   XShmSegmentInfo info;      /**< Must be first (used as XImage obdata). */
+   size_t size;
+   size_t used;
+   unsigned long serial;      /**< Request number of the last upload. */
+   unsigned int users;        /**< Number of images using the segment. */
+   char pooled;
+   struct SegmentNode *next;
+} SegmentNode;
+
+static SegmentNode *segments;
+static unsigned int segmentCount;
+static char haveShm;
+static char shmFailed;
+
+static char IsLocalDisplay(void);
+static int HandleShmError(Display *d, XErrorEvent *e);
+static SegmentNode *CreateSegment(size_t size, char pooled);
+static void ReleaseSegment(SegmentNode *sp);
+static char IsSegmentIdle(const SegmentNode *sp);
+static SegmentNode *GetSegment(size_t size, size_t *offset);
+
+#endif /* USE_SHM */
+
+/** Startup upload support. */
+void StartupUpload(void)
+{
+#ifdef USE_SHM
+   segments = NULL;
+   segmentCount = 0;
+   haveShm = IsLocalDisplay() && JXShmQueryExtension(display);
+   if(haveShm) {
+      Debug("MIT-SHM extension enabled");
+   } else {
+      Debug("MIT-SHM extension disabled");
+   }
+#endif
+}
+
+/** Shutdown upload support. */
+void ShutdownUpload(void)
+{
+#ifdef USE_SHM
+   if(segments) {
+      /* Make sure the server is done with the segments. */
+      JXSync(display, False);
+      while(segments) {
+         SegmentNode *sp = segments->next;
+         ReleaseSegment(segments);
+         segments = sp;
+      }
+   }
+   segmentCount = 0;
+#endif
+}
+
+#ifdef USE_SHM
+
+/** Determine if the display is on the local machine. */
+char IsLocalDisplay(void)
+{
+   const char *name = DisplayString(display);
+   return name[0] == ':' || !strncmp(name, "unix:", 5);
+}
+
+/** Error handler used while attaching a segment. */
+int HandleShmError(Display *d, XErrorEvent *e)
+{
+   shmFailed = 1;
+   return 0;
+}
+
+/** Create and attach a shared memory segment. */
+SegmentNode *CreateSegment(size_t size, char pooled)
+{
+   XErrorHandler oldHandler;
+   SegmentNode *sp = Allocate(sizeof(SegmentNode));
+
+   sp->info.shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if(JUNLIKELY(sp->info.shmid < 0)) {
+      Release(sp);
+      return NULL;
+   }
+   sp->info.shmaddr = shmat(sp->info.shmid, NULL, 0);
+   if(JUNLIKELY(sp->info.shmaddr == (char*)-1)) {
+      shmctl(sp->info.shmid, IPC_RMID, NULL);
+      Release(sp);
+      return NULL;
+   }
+   sp->info.readOnly = True;
+
+   /* Attaching fails if the server can't access our memory. */
+   JXSync(display, False);
+   shmFailed = 0;
+   oldHandler = JXSetErrorHandler(HandleShmError);
+   JXShmAttach(display, &sp->info);
+   JXSync(display, False);
+   JXSetErrorHandler(oldHandler);
+
+   /* The segment will be removed once both sides detach. */
+   shmctl(sp->info.shmid, IPC_RMID, NULL);
+   if(JUNLIKELY(shmFailed)) {
+      Debug("MIT-SHM attach failed; using XPutImage");
+      shmdt(sp->info.shmaddr);
+      Release(sp);
+      haveShm = 0;
+      return NULL;
+   }
+
+   sp->size = size;
+   sp->used = 0;
+   sp->serial = LastKnownRequestProcessed(display);
+   sp->users = 0;
+   sp->pooled = pooled;
+   sp->next = segments;
+   segments = sp;
+   if(pooled) {
+      segmentCount += 1;
+   }
+   return sp;
+}
+
+/** Detach and release a segment.
+ * The server must be done with the segment and it must be unlinked
+ * from the segment list.
+ */
+void ReleaseSegment(SegmentNode *sp)
+{
+   JXShmDetach(display, &sp->info);
+   shmdt(sp->info.shmaddr);
+   if(sp->pooled) {
+      segmentCount -= 1;
+   }
+   Release(sp);
+}
+
+/** Determine if the server is done with a segment. */
+char IsSegmentIdle(const SegmentNode *sp)
+{
+   const unsigned long processed = LastKnownRequestProcessed(display);
+   return sp->users == 0 && (long)(processed - sp->serial) >= 0;
+}
+
+/** Get a segment with room for an image. */
+SegmentNode *GetSegment(size_t size, size_t *offset)
+{
+   SegmentNode *sp;
+
+   if(size > SEGMENT_SIZE) {
+      *offset = 0;
+      return CreateSegment(size, 0);
+   }
+
+   /* Look for a segment with enough room, recycling idle segments. */
+   for(sp = segments; sp; sp = sp->next) {
+      if(!sp->pooled) {
+         continue;
+      }
+      if(sp->used > 0 && IsSegmentIdle(sp)) {
+         sp->used = 0;
+      }
+      if(sp->used + size <= sp->size) {
+         break;
+      }
+   }
+
+   /* Add a segment or wait for the server to finish with one. */
+   if(!sp) {
+      if(segmentCount < SEGMENT_COUNT) {
+         sp = CreateSegment(SEGMENT_SIZE, 1);
+      } else {
+         for(sp = segments; sp; sp = sp->next) {
+            if(sp->pooled && sp->users == 0) {
+               JXSync(display, False);
+               sp->used = 0;
+               break;
+            }
+         }
+      }
+      if(!sp) {
+         return NULL;
+      }
+   }
+
+   *offset = sp->used;
+   sp->used += (size + SEGMENT_ALIGN - 1) & ~(size_t)(SEGMENT_ALIGN - 1);
+   return sp;
+}
+
+#endif /* USE_SHM */
+
+/** Create an image for uploading to the server. */
+XImage *CreateUploadImage(int depth, unsigned int width, unsigned int height)
+{
+   XImage *image;
+
+#ifdef USE_SHM
+   if(haveShm) {
+      image = JXShmCreateImage(display, rootVisual, depth, ZPixmap, NULL,
+                               NULL, width, height);
+      if(JLIKELY(image)) {
+         const size_t size = (size_t)image->bytes_per_line * height;
+         size_t offset;
+         SegmentNode *sp = GetSegment(size, &offset);
+         if(JLIKELY(sp)) {
+            sp->users += 1;
+            image->obdata = (char*)&sp->info;
+            image->data = sp->info.shmaddr + offset;
+            return image;
+         }
+         JXDestroyImage(image);
+      }
+   }
+#endif
+
+   image = JXCreateImage(display, rootVisual, depth, ZPixmap, 0, NULL,
+                         width, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
+   return image;
+}
+
+/** Upload an image to a drawable. */
+void PutUploadImage(Drawable d, GC gc, XImage *image,
+                    unsigned int width, unsigned int height)
+{
+#ifdef USE_SHM
+   if(image->obdata) {
+      SegmentNode *sp = (SegmentNode*)image->obdata;
+      sp->serial = NextRequest(display);
+      JXShmPutImage(display, d, gc, image, 0, 0, 0, 0, width, height, False);
+      return;
+   }
+#endif
+   JXPutImage(display, d, gc, image, 0, 0, 0, 0, width, height);
+}
+
+/** Destroy an upload image. */
+void DestroyUploadImage(XImage *image)
+{
+#ifdef USE_SHM
+   if(image->obdata) {
+      SegmentNode *sp = (SegmentNode*)image->obdata;
+      image->obdata = NULL;
+      image->data = NULL;
+      JXDestroyImage(image);
+      sp->users -= 1;
+      if(!sp->pooled && sp->users == 0) {
+         SegmentNode **lp = &segments;
+         while(*lp != sp) {
+            lp = &(*lp)->next;
+         }
+         *lp = sp->next;
+         JXSync(display, False);
+         ReleaseSegment(sp);
+      }
+      return;
+   }
+#endif
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
+}
@@ -0,0 +1,45 @@
+/**
+ * @file upload.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Header for uploading image data to the X server.
+ *
+ */
+
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+/*@{*/
+#define InitializeUpload() (void)(0)
+void StartupUpload(void);
+void ShutdownUpload(void);
+#define DestroyUpload()    (void)(0)
+/*@}*/
+
+/** Create a ZPixmap image for uploading to the server.
+ * The image data is placed in shared memory when the MIT-SHM extension
+ * is usable and allocated normally otherwise. The data is uninitialized.
+ * @param depth The depth of the image (using the root visual).
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return The image.
+ */
+XImage *CreateUploadImage(int depth, unsigned int width, unsigned int height);
+
+/** Upload an image created with CreateUploadImage to a drawable.
+ * @param d The destination drawable.
+ * @param gc The graphics context to use.
+ * @param image The image.
+ * @param width The width of the area to upload.
+ * @param height The height of the area to upload.
+ */
+void PutUploadImage(Drawable d, GC gc, XImage *image,
+                    unsigned int width, unsigned int height);
+
+/** Destroy an image created with CreateUploadImage.
+ * @param image The image to destroy.
+ */
+void DestroyUploadImage(XImage *image);
+
+#endif /* UPLOAD_H */